@@ -0,0 +1,120 @@
+#ifndef DHT_AGGREGATE_HPP
+#define DHT_AGGREGATE_HPP
+
+#include "device.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dht {
+
+struct window_summary {
+  response min;
+  response max;
+  response mean;
+  size_t   count = 0;
+};
+
+/**
+ * Min, max and mean over consecutive non-overlapping windows of length
+ * readings per sensor. State is kept as one column per statistic across all
+ * sensors, so updating a whole tick of readings is a vectorizable loop.
+ */
+struct tumbling_window {
+  tumbling_window(size_t sensors, size_t length);
+
+  void update(size_t sensor, const response& reading);
+  // One reading per sensor, indexed by sensor
+  void update(const std::vector<response>& readings);
+
+  auto current(size_t sensor) const -> window_summary;
+  auto last(size_t sensor) const -> window_summary;
+  auto size() const noexcept -> size_t;
+
+ private:
+  void roll_over(size_t sensor);
+
+  size_t                length;
+  std::vector<uint32_t> count;
+  std::vector<float>    humidity_min, humidity_max, humidity_sum;
+  std::vector<float>    temperature_min, temperature_max, temperature_sum;
+  std::vector<window_summary> completed;
+};
+
+/**
+ * Min, max and mean over the last length readings per sensor. The mean keeps
+ * a running sum over a fixed ring of readings, min and max keep monotonic
+ * queues of ring slots whose front is the extreme, so every update is
+ * amortized O(1) in bounded state.
+ */
+struct sliding_window {
+  sliding_window(size_t sensors, size_t length);
+
+  void update(size_t sensor, const response& reading);
+  void update(const std::vector<response>& readings);
+
+  auto min(size_t sensor) const -> response;
+  auto max(size_t sensor) const -> response;
+  auto mean(size_t sensor) const -> response;
+  auto count(size_t sensor) const -> size_t;
+  auto size() const noexcept -> size_t;
+
+ private:
+  // length slots per sensor, used as a deque starting at front
+  struct slot_queue {
+    slot_queue(size_t sensors, size_t length);
+
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> front, used;
+  };
+
+  void push(slot_queue&               queue,
+            const std::vector<float>& ring,
+            size_t                    sensor,
+            uint32_t                  slot,
+            bool                      keep_smaller);
+  void evict(slot_queue& queue, size_t sensor, uint32_t slot);
+  auto extreme(const slot_queue&         queue,
+               const std::vector<float>& ring,
+               size_t                    sensor) const -> float;
+  void advance(size_t sensor, const response& reading);
+
+  size_t                length;
+  std::vector<uint32_t> head, filled;
+  std::vector<float>    humidity_ring, temperature_ring;
+  std::vector<double>   humidity_sum, temperature_sum;
+  slot_queue            humidity_min, humidity_max;
+  slot_queue            temperature_min, temperature_max;
+};
+
+/**
+ * Exponential moving average per sensor, seeded with the first reading.
+ */
+struct ema_filter {
+  ema_filter(size_t sensors, float alpha);
+
+  void update(size_t sensor, const response& reading);
+  void update(const std::vector<response>& readings);
+
+  auto value(size_t sensor) const -> response;
+  auto size() const noexcept -> size_t;
+
+ private:
+  float              alpha;
+  std::vector<float> humidity, temperature;
+};
+
+/**
+ * Dew point in °C using the Magnus formula.
+ */
+auto dew_point(const response& reading) noexcept -> float;
+
+/**
+ * Heat index in °C using the NOAA Rothfusz regression.
+ */
+auto heat_index(const response& reading) noexcept -> float;
+
+}  // namespace dht
+
+#endif  // DHT_AGGREGATE_HPP
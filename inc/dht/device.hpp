@@ -4,8 +4,12 @@
 #include "gpio.hpp"
 
 #include <bitset>
+#include <chrono>
+#include <cstdint>
 #include <iterator>
+#include <optional>
 #include <string>
+#include <vector>
 
 /**
  * @namespace dht
@@ -51,18 +55,61 @@ struct device {
   explicit device(gpio_handle&& handle);
   explicit device(int pin, const std::string& chip = default_chip);
 
+  /**
+   * Reads until a frame passes its checksum.
+   */
   auto poll() -> response;
 
+  /**
+   * A single reading, std::nullopt if the checksum does not match.
+   */
+  auto read() -> std::optional<response>;
+
+  /**
+   * Requests a reading and returns the raw response frame, valid until the
+   * next capture. Together with decode() this is poll() split in two, so the
+   * decoding can happen on another thread.
+   */
+  auto capture() -> const std::vector<event_data>&;
+
+  /**
+   * Decodes a captured frame, std::nullopt if the checksum does not match.
+   * line is only used for tracing.
+   */
+  auto static decode(const std::vector<event_data>& frame, uint32_t line = 0)
+      -> std::optional<response>;
+
   auto begin() noexcept -> iterator;
   auto static end() noexcept -> end_iterator;
 
- private:
   constexpr static auto response_bitcount  = 40;
   constexpr static auto response_bytecount = response_bitcount / 8;
 
-  auto read_data() -> std::bitset<response_bitcount>;
+  // Response preamble, two edges per bit and the closing low pulse
+  constexpr static size_t frame_edges = 2 + 2 * response_bitcount + 2;
+
+  // Switching to input may be slow enough to miss the 80µs preamble, the
+  // data bits and closing pulse are all that is needed
+  constexpr static size_t data_edges = frame_edges - 2;
+
+  // Host pulls LOW for 1ms minimum before releasing the line
+  constexpr static std::chrono::milliseconds start_signal{ 5 };
+
+  // Worst case duration of a response according to the datasheet
+  constexpr static std::chrono::microseconds frame_duration =
+      std::chrono::microseconds{ 40 + 80 + 80 + response_bitcount * (50 + 70)
+                                 + 50 };
+
+  // Sensors running a few µs long per bit must not miss the deadline
+  constexpr static std::chrono::microseconds frame_deadline =
+      frame_duration * 6 / 5;
+
+ private:
+  auto static decode_bits(const std::vector<event_data>& frame)
+      -> std::bitset<response_bitcount>;
 
-  gpio_handle handle;
+  gpio_handle             handle;
+  std::vector<event_data> frame;
 };
 
 }  // namespace dht
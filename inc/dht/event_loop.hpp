@@ -0,0 +1,77 @@
+#ifndef DHT_EVENT_LOOP_HPP
+#define DHT_EVENT_LOOP_HPP
+
+#include "gpio.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dht {
+
+enum struct event_backend {
+  automatic,
+  io_uring,
+  epoll,
+};
+
+struct line_event {
+  size_t     line;  // index returned by event_loop::add()
+  event_data event;
+};
+
+using namespace std::chrono_literals;
+/**
+ * Captures edge events from many lines at once.
+ *
+ * The io_uring backend keeps a read outstanding on every registered line and
+ * waits with a single timeout request, so each wait() costs one syscall
+ * regardless of the number of lines. When io_uring is unavailable the
+ * automatic backend falls back to epoll.
+ *
+ * Registered gpio_handles must outlive the event_loop.
+ */
+struct event_loop {
+  explicit event_loop(event_backend backend   = event_backend::automatic,
+                      uint32_t      max_lines = 64);
+
+  ~event_loop() noexcept;
+  event_loop(event_loop&& old) noexcept;
+  auto operator=(event_loop&& rhs) noexcept -> event_loop&;
+
+  event_loop(const event_loop&) = delete;
+  auto operator=(const event_loop&) -> event_loop& = delete;
+
+  auto add(gpio_handle& handle, event_request event = event_request::any)
+      -> size_t;
+
+  /**
+   * Appends every edge captured within timeout to events and returns the
+   * number appended, zero if the timeout expired or notify() was called.
+   */
+  auto wait(std::vector<line_event>&  events,
+            std::chrono::milliseconds timeout = 100ms) -> size_t;
+
+  /**
+   * Makes the current or next wait() return early. Safe to call from any
+   * thread, wakeups before a wait() are not lost.
+   */
+  void notify() noexcept;
+
+  auto backend() const noexcept -> event_backend;
+  auto size() const noexcept -> size_t;
+
+  struct loop_backend;
+
+ private:
+  std::unique_ptr<loop_backend> impl;
+  event_backend                 kind;
+  uint32_t                      max_lines;
+  size_t                        lines = 0;
+};
+
+}  // namespace dht
+
+#endif  // DHT_EVENT_LOOP_HPP
@@ -5,9 +5,12 @@
 
 #include <chrono>
 #include <cstdint>
+#include <cstddef>
 #include <exception>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
 
 /**
  * @namespace dht
@@ -40,11 +43,15 @@ enum struct direction {
 struct event_data {
   std::chrono::steady_clock::time_point timestamp;
   event_type                            type;
+  uint32_t                              sequence = 0;  // per line, by kernel
 };
 
+auto to_event_data(const gpio_v2_line_event& event) noexcept -> event_data;
+
 using namespace std::chrono_literals;
 /**
- * gpio_handle does stuff
+ * A single line of a gpiochip. The line is requested once and switched
+ * between input and output in place, so its file descriptor stays the same.
  */
 struct gpio_handle {
   explicit gpio_handle(uint32_t pin, const std::string& chip = default_chip);
@@ -59,18 +66,43 @@ struct gpio_handle {
   gpio_handle(const gpio_handle&) = delete;
   auto operator=(const gpio_handle&) -> gpio_handle& = delete;
 
+  /**
+   * Waits for the next edge, throwing timeout_exceeded after timeout. With
+   * io_uring the read is linked to its timeout, costing a single syscall.
+   */
   auto listen(event_request             event   = event_request::any,
               std::chrono::milliseconds timeout = 100ms) -> event_data;
   void write(bool value = false);
   void write(int value);
 
+  /**
+   * Configures the line for edge events if needed and returns the file
+   * descriptor the events are read from, valid across direction changes.
+   * The handle keeps ownership.
+   */
+  auto event_fd(event_request event = event_request::any) -> int;
+
+  /**
+   * Reads edges into frame until it holds count of them, under one deadline
+   * for the whole frame. Throws frame_error as soon as the kernel sequence
+   * numbers show a dropped event, two edges of the same type arrive in a row
+   * or the deadline passes, instead of waiting out per-edge timeouts.
+   * Failures are not traced, the caller decides whether they are final.
+   */
+  void capture(std::vector<event_data>&  frame,
+               size_t                    count,
+               std::chrono::microseconds deadline,
+               event_request             event = event_request::any);
+
   auto get_pin() noexcept -> int;
 
   friend void swap(gpio_handle& a, gpio_handle& b) noexcept;
 
  private:
+  void configure(const gpio_v2_line_config& config);
   void set_input(event_request event);
   void set_output(bool value);
+  void discard_events();
   void static try_close(int& fd);
 
   uint32_t         pin;
@@ -90,6 +122,27 @@ struct timeout_exceeded : std::exception {
   std::chrono::milliseconds timeout;
 };
 
+struct frame_error : std::runtime_error {
+  enum struct reason {
+    deadline_exceeded,
+    sequence_gap,  // the kernel dropped events, e.g. on buffer overflow
+    missing_edge,  // an edge never reached the kernel
+  };
+
+  frame_error(reason why, size_t captured, const std::string& message);
+
+  reason why;
+  size_t captured;
+};
+
+/**
+ * Appends edge to a frame being captured from a single line. Throws
+ * frame_error if the kernel sequence numbers show a dropped event, or if
+ * both edges are requested and edge has the type of the previous one.
+ */
+void append_edge(std::vector<event_data>& frame,
+                 const event_data&        edge,
+                 event_request            event = event_request::any);
 
 }  // namespace dht
 #endif  // DHT_GPIO_HPP
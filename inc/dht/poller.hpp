@@ -0,0 +1,265 @@
+#ifndef DHT_POLLER_HPP
+#define DHT_POLLER_HPP
+
+#include "device.hpp"
+#include "event_loop.hpp"
+#include "gpio.hpp"
+#include "sampler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dht {
+
+struct sensor_location {
+  std::string chip;
+  uint32_t    pin;
+};
+
+/**
+ * Assigns sensors to workers in contiguous runs of (chip, pin) order, so the
+ * lines of a chip are spread over as few workers as possible while every
+ * worker gets an equal share. Returns the worker index of each sensor.
+ */
+auto shard_sensors(const std::vector<sensor_location>& sensors, size_t workers)
+    -> std::vector<size_t>;
+
+/**
+ * One job deque per worker. A worker pops its own newest job first, still
+ * hot in its cache, and otherwise steals the oldest job of another worker.
+ * Workers about to block park, so a producer wakes at most one of them.
+ */
+template <typename Job>
+struct work_queues {
+  explicit work_queues(size_t workers) : queues(workers) {
+  }
+
+  /**
+   * Queues job on the deque of worker and returns its new length.
+   */
+  auto push(size_t worker, Job job) -> size_t {
+    auto&            q = queues[worker];
+    std::scoped_lock lock(q.m);
+    q.jobs.push_back(std::move(job));
+    return q.jobs.size();
+  }
+
+  auto pop(size_t worker) -> std::optional<Job> {
+    for (size_t i = 0; i < queues.size(); i++) {
+      auto&            q = queues[(worker + i) % queues.size()];
+      std::scoped_lock lock(q.m);
+      if (q.jobs.empty()) continue;
+
+      std::optional<Job> job;
+      if (i == 0) {
+        job = std::move(q.jobs.back());
+        q.jobs.pop_back();
+      } else {
+        job = std::move(q.jobs.front());
+        q.jobs.pop_front();
+      }
+      return job;
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * Marks worker as idle and returns true, unless a job was queued in the
+   * meantime. A job pushed afterwards finds worker in claim_idle().
+   */
+  auto park(size_t worker) -> bool {
+    queues[worker].idle = true;
+    for (auto& q: queues) {
+      std::scoped_lock lock(q.m);
+      if (!q.jobs.empty()) {
+        queues[worker].idle = false;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unpark(size_t worker) noexcept {
+    queues[worker].idle = false;
+  }
+
+  /**
+   * Picks one parked worker other than worker to be woken, and unparks it
+   * so no other producer picks it too.
+   */
+  auto claim_idle(size_t worker) -> std::optional<size_t> {
+    for (size_t i = 1; i < queues.size(); i++) {
+      auto w        = (worker + i) % queues.size();
+      bool expected = true;
+      if (queues[w].idle.compare_exchange_strong(expected, false)) return w;
+    }
+    return std::nullopt;
+  }
+
+  auto size() const noexcept -> size_t {
+    return queues.size();
+  }
+
+ private:
+  struct alignas(64) queue {
+    std::mutex        m;
+    std::deque<Job>   jobs;
+    std::atomic<bool> idle{ false };
+  };
+
+  std::vector<queue> queues;
+};
+
+/**
+ * The capture cycle of one sensor in a poller worker: pull the line low,
+ * release it, collect edges until the frame is complete or its deadline
+ * passed, and reschedule once the frame was decoded. Time is passed in and
+ * the line is driven by the caller.
+ */
+struct capture_cycle {
+  using clock_type = std::chrono::steady_clock;
+
+  enum struct phase { idle, signalling, capturing, decoding };
+
+  capture_cycle(const sampling_policy& policy, clock_type::time_point now);
+
+  /**
+   * Enters the next phase once due and returns it for the caller to act
+   * upon: pull the line low for signalling, release it for capturing and
+   * hand frame() to a decoder for decoding. A frame short of data_edges at
+   * its deadline throws frame_error and retries at the minimum interval.
+   */
+  auto step(clock_type::time_point now) -> std::optional<phase>;
+
+  /**
+   * Appends an edge of the frame being captured and returns true once the
+   * frame is complete, ignoring edges from before the line was released.
+   * Throws frame_error like append_edge() and retries at the minimum
+   * interval.
+   */
+  auto edge(const event_data& event, clock_type::time_point now) -> bool;
+
+  /**
+   * Reschedules from the release of the line once the frame was decoded,
+   * at the minimum interval if there was no valid reading.
+   */
+  void finish(const std::optional<response>& reading);
+
+  /**
+   * Abandons the cycle, e.g. if the line could not be driven, and retries
+   * at the minimum interval.
+   */
+  void retry(clock_type::time_point now);
+
+  /**
+   * The captured edges, swapped out while decoding and back before
+   * finish() so the buffer is reused.
+   */
+  auto frame() noexcept -> std::vector<event_data>&;
+
+  auto state() const noexcept -> phase;
+
+  /**
+   * When step() has to be called next, time_point::max() while decoding.
+   */
+  auto due() const noexcept -> clock_type::time_point;
+
+ private:
+  adaptive_interval       schedule;
+  phase                   current = phase::idle;
+  clock_type::time_point  next;
+  clock_type::time_point  released{};
+  std::vector<event_data> edges;
+};
+
+struct poller_options {
+  size_t          workers     = 0;  // one per core if 0
+  bool            pin_workers = true;
+  event_backend   backend     = event_backend::automatic;
+  sampling_policy policy;
+};
+
+/**
+ * Polls many sensors from a pool of worker threads, each pinned to a core.
+ *
+ * Every worker owns a shard of the sensors: their lines, and with them the
+ * chip file descriptors, are created, driven and destroyed on that thread
+ * only. A worker registers its lines once in its own event_loop and drives
+ * the start signal, capture and deadline of every sensor from it, each
+ * sensor sampled at its own adaptive_interval. Captured frames are queued
+ * as decode and publish jobs on the worker's deque, from which idle workers
+ * steal.
+ *
+ * publish is called concurrently from all workers.
+ */
+struct poller {
+  using callback = std::function<void(size_t sensor, const response& reading)>;
+
+  explicit poller(callback publish, poller_options options = {});
+  ~poller() noexcept;
+
+  poller(const poller&) = delete;
+  auto operator=(const poller&) -> poller& = delete;
+  poller(poller&&)                         = delete;
+  auto operator=(poller&&) -> poller& = delete;
+
+  /**
+   * Registers a sensor, only allowed before start().
+   */
+  auto add(uint32_t pin, const std::string& chip = default_chip) -> size_t;
+
+  /**
+   * Spawns the workers and returns once all of them opened their lines,
+   * rethrowing the first error if any failed.
+   */
+  void start();
+  void stop() noexcept;
+
+  auto workers() const noexcept -> size_t;
+  auto size() const noexcept -> size_t;
+
+  struct worker;
+
+ private:
+  struct job {
+    size_t                  sensor;
+    size_t                  owner;
+    size_t                  slot;  // index into the owner's shard
+    std::vector<event_data> frame;
+  };
+
+  void run(size_t index);
+  void queue_job(size_t index, job next);
+  auto next_job(size_t index) -> bool;
+
+  callback                             publish;
+  poller_options                       options;
+  std::vector<sensor_location>         sensors;
+  std::vector<std::unique_ptr<worker>> pool;
+  std::unique_ptr<work_queues<job>>    queues;
+
+  // Workers are woken through their event_loop, the condition variable only
+  // serves start() and the barriers around the worker loops
+  std::atomic<bool>       running{ false };
+  std::mutex              wake_mutex;
+  std::condition_variable wake;
+  size_t                  ready  = 0;
+  size_t                  exited = 0;
+  std::exception_ptr      startup_error;
+};
+
+}  // namespace dht
+
+#endif  // DHT_POLLER_HPP
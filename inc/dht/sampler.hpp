@@ -0,0 +1,90 @@
+#ifndef DHT_SAMPLER_HPP
+#define DHT_SAMPLER_HPP
+
+#include "device.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace dht {
+
+using namespace std::chrono_literals;
+
+struct sampling_policy {
+  // DHT22 datasheet minimum, a DHT11 may be sampled every second
+  std::chrono::milliseconds min_interval = 2s;
+  // Upper bound on how stale a reading may get while nothing changes
+  std::chrono::milliseconds max_interval = 60s;
+
+  float humidity_delta    = 0.5f;  // %RH
+  float temperature_delta = 0.2f;  // °C
+  float backoff           = 2.0f;  // at least 1
+};
+
+/**
+ * Sampling interval of a single sensor. The interval grows by the backoff
+ * factor for every reading within the deltas of the last significant reading,
+ * and drops back to the minimum as soon as a reading falls outside them.
+ *
+ * Throws std::invalid_argument if min_interval exceeds max_interval or the
+ * backoff is below 1.
+ */
+struct adaptive_interval {
+  explicit adaptive_interval(const sampling_policy& policy = {});
+
+  auto update(const response& reading) noexcept -> std::chrono::milliseconds;
+  auto reset() noexcept -> std::chrono::milliseconds;
+  auto interval() const noexcept -> std::chrono::milliseconds;
+
+ private:
+  sampling_policy           policy;
+  std::chrono::milliseconds current;
+  response                  reference;
+  bool                      has_reference = false;
+};
+
+struct sample {
+  size_t                                sensor;
+  response                              reading;
+  std::chrono::steady_clock::time_point timestamp;
+};
+
+/**
+ * Polls a set of devices, each at its own adaptive_interval.
+ * Added devices must outlive the sampler, every poll of one is a single
+ * device::read() and a checksum mismatch counts as a failed poll.
+ */
+struct sampler {
+  using source = std::function<response()>;
+
+  auto add(device& unit, const sampling_policy& policy = {}) -> size_t;
+
+  /**
+   * Adds any callable producing readings, polled like a device.
+   */
+  auto add(source poll, const sampling_policy& policy = {}) -> size_t;
+
+  /**
+   * Sleeps until the most overdue sensor is due and polls it. A failing
+   * poll is rethrown after rescheduling the sensor at the minimum interval.
+   */
+  auto next() -> sample;
+
+  auto interval(size_t sensor) const -> std::chrono::milliseconds;
+  auto size() const noexcept -> size_t;
+
+ private:
+  struct entry {
+    source                                poll;
+    adaptive_interval                     schedule;
+    std::chrono::steady_clock::time_point due;
+  };
+
+  std::vector<entry> sensors;
+};
+
+}  // namespace dht
+
+#endif  // DHT_SAMPLER_HPP
@@ -0,0 +1,178 @@
+#ifndef DHT_TRACE_HPP
+#define DHT_TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace dht {
+
+enum struct trace_kind : uint8_t {
+  frame_start,
+  frame_end,
+  edge_count,
+  crc_error,
+  timeout,
+  close_failed,
+  frame_error,
+};
+
+/**
+ * A single preformatted trace record. Trivially copyable so consumers can
+ * dump drained events verbatim in binary form.
+ *
+ * The meaning of value and expected depends on kind: the edge count for
+ * edge_count, computed and received checksum for crc_error, the timeout in
+ * milliseconds for timeout, errno for close_failed, where line holds the
+ * file descriptor instead of the line offset, and the frame_error::reason and
+ * edges captured before failing for frame_error.
+ */
+struct trace_event {
+  std::chrono::steady_clock::time_point timestamp;
+  trace_kind                            kind;
+  uint32_t                              line     = 0;
+  uint32_t                              value    = 0;
+  uint32_t                              expected = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<trace_event>);
+
+/**
+ * Receives trace events from the library. record() is called from the
+ * reading thread and must neither block nor allocate.
+ */
+struct trace_sink {
+  trace_sink()                  = default;
+  trace_sink(const trace_sink&) = delete;
+  auto operator=(const trace_sink&) -> trace_sink& = delete;
+  virtual ~trace_sink()                            = default;
+
+  virtual void record(const trace_event& event) noexcept = 0;
+};
+
+struct null_sink final : trace_sink {
+  void record(const trace_event& /* unused */) noexcept override {
+  }
+};
+
+/**
+ * Bounded lock-free multi-producer ring buffer of trace events. Events
+ * recorded while the buffer is full are dropped and counted, so recording
+ * never waits on the consumer.
+ */
+template <size_t Capacity>
+struct ring_sink final : trace_sink {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "ring_sink capacity must be a power of two");
+
+  ring_sink() noexcept {
+    for (size_t i = 0; i < Capacity; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  void record(const trace_event& event) noexcept override {
+    auto pos = head.load(std::memory_order_relaxed);
+    while (true) {
+      auto& slot = slots[pos & mask];
+      auto  seq  = slot.sequence.load(std::memory_order_acquire);
+      auto  diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          slot.event = event;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return;
+        }
+      } else if (diff < 0) {
+        dropped_events.fetch_add(1, std::memory_order_relaxed);
+        return;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Pops the oldest event, returns false if the buffer is empty.
+   * Only one thread may consume at a time.
+   */
+  auto try_pop(trace_event& event) noexcept -> bool {
+    auto  pos  = tail.load(std::memory_order_relaxed);
+    auto& slot = slots[pos & mask];
+    auto  seq  = slot.sequence.load(std::memory_order_acquire);
+    if (static_cast<std::ptrdiff_t>(seq - (pos + 1)) < 0) return false;
+
+    event = slot.event;
+    slot.sequence.store(pos + Capacity, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Passes every currently buffered event to fn, returns the number drained.
+   */
+  template <typename Fn>
+  auto drain(Fn&& fn) -> size_t {
+    size_t      n = 0;
+    trace_event event{};
+    while (try_pop(event)) {
+      fn(event);
+      n++;
+    }
+    return n;
+  }
+
+  auto dropped() const noexcept -> uint64_t {
+    return dropped_events.load(std::memory_order_relaxed);
+  }
+
+ private:
+  constexpr static size_t mask = Capacity - 1;
+
+  struct slot_type {
+    std::atomic<size_t> sequence;
+    trace_event         event;
+  };
+
+  std::array<slot_type, Capacity> slots;
+  alignas(64) std::atomic<size_t> head{ 0 };
+  alignas(64) std::atomic<size_t> tail{ 0 };
+  std::atomic<uint64_t> dropped_events{ 0 };
+};
+
+/**
+ * Installs the sink receiving all library trace events, nullptr disables
+ * tracing. The sink must outlive every device and gpio_handle using it.
+ */
+void set_trace_sink(trace_sink* sink) noexcept;
+auto get_trace_sink() noexcept -> trace_sink*;
+
+namespace detail {
+extern std::atomic<trace_sink*> active_sink;
+}  // namespace detail
+
+#ifdef DHT_DISABLE_TRACING
+inline void trace(trace_kind /* unused */,
+                  uint32_t /* unused */,
+                  uint32_t /* unused */ = 0,
+                  uint32_t /* unused */ = 0) noexcept {
+}
+#else
+inline void trace(trace_kind kind,
+                  uint32_t   line,
+                  uint32_t   value    = 0,
+                  uint32_t   expected = 0) noexcept {
+  auto* sink = detail::active_sink.load(std::memory_order_acquire);
+  if (sink == nullptr) return;
+  auto now = std::chrono::steady_clock::now();
+  sink->record({ now, kind, line, value, expected });
+}
+#endif
+
+}  // namespace dht
+
+#endif  // DHT_TRACE_HPP
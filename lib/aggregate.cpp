@@ -0,0 +1,351 @@
+#include <dht/aggregate.hpp>
+#include <dht/device.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace dht {
+
+namespace {
+
+constexpr auto infinity = std::numeric_limits<float>::infinity();
+
+void check_length(size_t length) {
+  if (length == 0) {
+    throw std::invalid_argument("window length must be at least 1");
+  }
+}
+
+void check_sensor(size_t sensor, size_t sensors) {
+  if (sensor >= sensors) {
+    throw std::out_of_range("sensor " + std::to_string(sensor)
+                            + " out of range, have "
+                            + std::to_string(sensors));
+  }
+}
+
+void check_tick(const std::vector<response>& readings, size_t sensors) {
+  if (readings.size() != sensors) {
+    throw std::invalid_argument("expected one reading per sensor, got "
+                                + std::to_string(readings.size()) + " for "
+                                + std::to_string(sensors) + " sensors");
+  }
+}
+
+}  // namespace
+
+tumbling_window::tumbling_window(size_t sensors, size_t length)
+    : length(length)
+    , count(sensors, 0)
+    , humidity_min(sensors, infinity)
+    , humidity_max(sensors, -infinity)
+    , humidity_sum(sensors, 0)
+    , temperature_min(sensors, infinity)
+    , temperature_max(sensors, -infinity)
+    , temperature_sum(sensors, 0)
+    , completed(sensors) {
+  check_length(length);
+}
+
+void tumbling_window::update(size_t sensor, const response& reading) {
+  check_sensor(sensor, size());
+
+  auto i = sensor;
+  humidity_min[i]    = std::min(humidity_min[i], reading.humidity);
+  humidity_max[i]    = std::max(humidity_max[i], reading.humidity);
+  humidity_sum[i]    += reading.humidity;
+  temperature_min[i] = std::min(temperature_min[i], reading.temperature);
+  temperature_max[i] = std::max(temperature_max[i], reading.temperature);
+  temperature_sum[i] += reading.temperature;
+
+  if (++count[i] == length) roll_over(i);
+}
+
+void tumbling_window::update(const std::vector<response>& readings) {
+  auto n = size();
+  check_tick(readings, n);
+
+  // Branch free so the compiler can vectorize across sensors
+  for (size_t i = 0; i < n; i++) {
+    auto h = readings[i].humidity;
+    auto t = readings[i].temperature;
+    humidity_min[i]    = std::min(humidity_min[i], h);
+    humidity_max[i]    = std::max(humidity_max[i], h);
+    humidity_sum[i]    += h;
+    temperature_min[i] = std::min(temperature_min[i], t);
+    temperature_max[i] = std::max(temperature_max[i], t);
+    temperature_sum[i] += t;
+    count[i]++;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (count[i] == length) roll_over(i);
+  }
+}
+
+auto tumbling_window::current(size_t sensor) const -> window_summary {
+  check_sensor(sensor, size());
+
+  auto i = sensor;
+  if (count[i] == 0) return {};
+
+  auto n = static_cast<float>(count[i]);
+  return { { humidity_min[i], temperature_min[i] },
+           { humidity_max[i], temperature_max[i] },
+           { humidity_sum[i] / n, temperature_sum[i] / n },
+           count[i] };
+}
+
+auto tumbling_window::last(size_t sensor) const -> window_summary {
+  check_sensor(sensor, size());
+  return completed[sensor];
+}
+
+auto tumbling_window::size() const noexcept -> size_t {
+  return count.size();
+}
+
+void tumbling_window::roll_over(size_t sensor) {
+  auto i       = sensor;
+  completed[i] = current(i);
+
+  count[i]           = 0;
+  humidity_min[i]    = infinity;
+  humidity_max[i]    = -infinity;
+  humidity_sum[i]    = 0;
+  temperature_min[i] = infinity;
+  temperature_max[i] = -infinity;
+  temperature_sum[i] = 0;
+}
+
+sliding_window::slot_queue::slot_queue(size_t sensors, size_t length)
+    : slots(sensors * length, 0), front(sensors, 0), used(sensors, 0) {
+}
+
+sliding_window::sliding_window(size_t sensors, size_t length)
+    : length(length)
+    , head(sensors, 0)
+    , filled(sensors, 0)
+    , humidity_ring(sensors * length, 0)
+    , temperature_ring(sensors * length, 0)
+    , humidity_sum(sensors, 0)
+    , temperature_sum(sensors, 0)
+    , humidity_min(sensors, length)
+    , humidity_max(sensors, length)
+    , temperature_min(sensors, length)
+    , temperature_max(sensors, length) {
+  check_length(length);
+}
+
+void sliding_window::update(size_t sensor, const response& reading) {
+  check_sensor(sensor, size());
+
+  auto i    = sensor;
+  auto slot = i * length + head[i];
+
+  // Slots not yet filled hold zero, so evicting them is a no-op
+  humidity_sum[i] += reading.humidity - humidity_ring[slot];
+  temperature_sum[i] += reading.temperature - temperature_ring[slot];
+
+  advance(i, reading);
+}
+
+void sliding_window::update(const std::vector<response>& readings) {
+  auto n = size();
+  check_tick(readings, n);
+
+  for (size_t i = 0; i < n; i++) {
+    auto slot = i * length + head[i];
+    humidity_sum[i] += readings[i].humidity - humidity_ring[slot];
+    temperature_sum[i] += readings[i].temperature - temperature_ring[slot];
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    advance(i, readings[i]);
+  }
+}
+
+void sliding_window::advance(size_t sensor, const response& reading) {
+  auto i    = sensor;
+  auto slot = head[i];
+
+  // Once full, the slot about to be overwritten holds the oldest reading
+  if (filled[i] == length) {
+    evict(humidity_min, i, slot);
+    evict(humidity_max, i, slot);
+    evict(temperature_min, i, slot);
+    evict(temperature_max, i, slot);
+  }
+
+  humidity_ring[i * length + slot]    = reading.humidity;
+  temperature_ring[i * length + slot] = reading.temperature;
+
+  push(humidity_min, humidity_ring, i, slot, true);
+  push(humidity_max, humidity_ring, i, slot, false);
+  push(temperature_min, temperature_ring, i, slot, true);
+  push(temperature_max, temperature_ring, i, slot, false);
+
+  head[i]   = slot + 1 == length ? 0 : slot + 1;
+  filled[i] = std::min<uint32_t>(filled[i] + 1, length);
+}
+
+void sliding_window::push(slot_queue&               queue,
+                          const std::vector<float>& ring,
+                          size_t                    sensor,
+                          uint32_t                  slot,
+                          bool                      keep_smaller) {
+  auto  base  = sensor * length;
+  auto  value = ring[base + slot];
+  auto& front = queue.front[sensor];
+  auto& used  = queue.used[sensor];
+
+  // Older readings that can never be the extreme again are dropped
+  while (used > 0) {
+    auto back  = queue.slots[base + (front + used - 1) % length];
+    auto older = ring[base + back];
+    if (keep_smaller ? older < value : older > value) break;
+    used--;
+  }
+
+  queue.slots[base + (front + used) % length] = slot;
+  used++;
+}
+
+void sliding_window::evict(slot_queue& queue, size_t sensor, uint32_t slot) {
+  auto  base  = sensor * length;
+  auto& front = queue.front[sensor];
+  auto& used  = queue.used[sensor];
+
+  if (used > 0 && queue.slots[base + front] == slot) {
+    front = front + 1 == length ? 0 : front + 1;
+    used--;
+  }
+}
+
+auto sliding_window::extreme(const slot_queue&         queue,
+                             const std::vector<float>& ring,
+                             size_t                    sensor) const -> float {
+  auto base = sensor * length;
+  return ring[base + queue.slots[base + queue.front[sensor]]];
+}
+
+auto sliding_window::min(size_t sensor) const -> response {
+  check_sensor(sensor, size());
+  if (filled[sensor] == 0) return {};
+  return { extreme(humidity_min, humidity_ring, sensor),
+           extreme(temperature_min, temperature_ring, sensor) };
+}
+
+auto sliding_window::max(size_t sensor) const -> response {
+  check_sensor(sensor, size());
+  if (filled[sensor] == 0) return {};
+  return { extreme(humidity_max, humidity_ring, sensor),
+           extreme(temperature_max, temperature_ring, sensor) };
+}
+
+auto sliding_window::mean(size_t sensor) const -> response {
+  check_sensor(sensor, size());
+
+  auto i = sensor;
+  if (filled[i] == 0) return {};
+
+  auto n = static_cast<double>(filled[i]);
+  return { static_cast<float>(humidity_sum[i] / n),
+           static_cast<float>(temperature_sum[i] / n) };
+}
+
+auto sliding_window::count(size_t sensor) const -> size_t {
+  check_sensor(sensor, size());
+  return filled[sensor];
+}
+
+auto sliding_window::size() const noexcept -> size_t {
+  return head.size();
+}
+
+ema_filter::ema_filter(size_t sensors, float alpha)
+    : alpha(alpha)
+    , humidity(sensors, std::numeric_limits<float>::quiet_NaN())
+    , temperature(sensors, std::numeric_limits<float>::quiet_NaN()) {
+  if (!(alpha > 0 && alpha <= 1)) {
+    throw std::invalid_argument("ema_filter alpha must be in (0, 1]");
+  }
+}
+
+void ema_filter::update(size_t sensor, const response& reading) {
+  check_sensor(sensor, size());
+
+  auto i = sensor;
+  if (std::isnan(humidity[i])) {
+    humidity[i]    = reading.humidity;
+    temperature[i] = reading.temperature;
+    return;
+  }
+  humidity[i] += alpha * (reading.humidity - humidity[i]);
+  temperature[i] += alpha * (reading.temperature - temperature[i]);
+}
+
+void ema_filter::update(const std::vector<response>& readings) {
+  auto n = size();
+  check_tick(readings, n);
+
+  for (size_t i = 0; i < n; i++) {
+    auto h = readings[i].humidity;
+    auto t = readings[i].temperature;
+
+    // NaN marks a sensor without readings, seed it with the first one
+    auto seeded    = !std::isnan(humidity[i]);
+    humidity[i]    = seeded ? humidity[i] + alpha * (h - humidity[i]) : h;
+    temperature[i] = seeded ? temperature[i] + alpha * (t - temperature[i]) : t;
+  }
+}
+
+auto ema_filter::value(size_t sensor) const -> response {
+  check_sensor(sensor, size());
+  return { humidity[sensor], temperature[sensor] };
+}
+
+auto ema_filter::size() const noexcept -> size_t {
+  return humidity.size();
+}
+
+auto dew_point(const response& reading) noexcept -> float {
+  constexpr auto a = 17.62f;
+  constexpr auto b = 243.12f;
+
+  auto t     = reading.temperature;
+  auto gamma = std::log(reading.humidity / 100.0f) + a * t / (b + t);
+  return b * gamma / (a - gamma);
+}
+
+auto heat_index(const response& reading) noexcept -> float {
+  auto t  = reading.temperature * 9.0f / 5.0f + 32.0f;
+  auto rh = reading.humidity;
+
+  // Steadman's approximation is accurate enough below 80°F
+  auto hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+
+  if ((hi + t) / 2.0f >= 80.0f) {
+    hi = -42.379f + 2.04901523f * t + 10.14333127f * rh
+         - 0.22475541f * t * rh - 0.00683783f * t * t
+         - 0.05481717f * rh * rh + 0.00122874f * t * t * rh
+         + 0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+
+    if (rh < 13.0f && t >= 80.0f && t <= 112.0f) {
+      hi -= (13.0f - rh) / 4.0f
+            * std::sqrt((17.0f - std::abs(t - 95.0f)) / 17.0f);
+    } else if (rh > 85.0f && t >= 80.0f && t <= 87.0f) {
+      hi += (rh - 85.0f) / 10.0f * (87.0f - t) / 5.0f;
+    }
+  }
+
+  return (hi - 32.0f) * 5.0f / 9.0f;
+}
+
+}  // namespace dht
@@ -1,15 +1,18 @@
 #include <dht/device.hpp>
 #include <dht/gpio.hpp>
+#include <dht/trace.hpp>
 
 #include <array>
 #include <bitset>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <iostream>
 #include <numeric>
+#include <optional>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 namespace dht {
 
@@ -18,10 +21,11 @@ namespace {
 template <size_t N>
 constexpr auto bitset_to_bytes(const std::bitset<N>& set) {
   std::array<uint8_t, N / 8> bytes{};
-  for (int i = 0; i < bytes.size(); i++) {
+  for (size_t i = 0; i < bytes.size(); i++) {
     uint8_t current{ 0 };
-    for (int j = 0; j < 8; j++) {
-      current = set[i * 8 + j] << j;
+    for (size_t j = 0; j < 8; j++) {
+      // Bits arrive most significant first
+      current |= static_cast<uint8_t>(set[i * 8 + j] << (7 - j));
     }
     bytes[i] = current;
   }
@@ -37,72 +41,105 @@ device::device(int pin, const std::string& chip) : handle(pin, chip) {
 }
 
 auto device::poll() -> response {
-  auto data      = std::array<uint8_t, response_bytecount>{};
-  auto valid_crc = false;
-
-  while (!valid_crc) {
-    data          = bitset_to_bytes(read_data());
-    auto checksum = data[4];
-    auto crc      = std::accumulate(data.begin(), data.begin() + 4, uint8_t(0));
-    valid_crc     = crc == checksum;
-    if (!valid_crc) {
-      std::cerr << "Invalid CRC reading: got " << std::hex << crc
-                << ", expected " << checksum << '\n';
+  while (true) {
+    auto reading = read();
+    if (reading) return *reading;
+  }
+}
+
+auto device::read() -> std::optional<response> {
+  return decode(capture(), handle.get_pin());
+}
+
+auto device::capture() -> const std::vector<event_data>& {
+  auto pin = handle.get_pin();
+  trace(trace_kind::frame_start, pin);
+
+  // Host pulls LOW, then releases the line to the pull-up resistor by
+  // switching to input. The sensor answers 20-40µs later.
+  handle.write(false);
+  std::this_thread::sleep_for(start_signal);
+
+  try {
+    handle.capture(frame, frame_edges, frame_deadline);
+  } catch (const frame_error& e) {
+    if (e.why != frame_error::reason::deadline_exceeded
+        || frame.size() < data_edges) {
+      trace(trace_kind::frame_error,
+            pin,
+            static_cast<uint32_t>(e.why),
+            e.captured);
+      throw;
     }
   }
+  trace(trace_kind::edge_count, pin, frame.size());
+
+  // After communication ends, the Line is pulled HIGH by the pull-up resistor
+  // and enters IDLE state.
+  trace(trace_kind::frame_end, pin);
+  return frame;
+}
+
+auto device::decode(const std::vector<event_data>& frame, uint32_t line)
+    -> std::optional<response> {
+  std::bitset<response_bitcount> bits;
+  try {
+    bits = decode_bits(frame);
+  } catch (const frame_error& e) {
+    trace(trace_kind::frame_error,
+          line,
+          static_cast<uint32_t>(e.why),
+          e.captured);
+    throw;
+  }
+
+  auto data     = bitset_to_bytes(bits);
+  auto checksum = data[4];
+  auto crc      = std::accumulate(data.begin(), data.begin() + 4, uint8_t(0));
+  if (crc != checksum) {
+    trace(trace_kind::crc_error, line, crc, checksum);
+    return std::nullopt;
+  }
 
   auto humidity    = static_cast<float>(data[0] << 8 | data[1]) / 10.0f;
   auto temperature = static_cast<float>(data[2] << 8 | data[3]) / 10.0f;
 
-  return { humidity, temperature };
+  return response{ humidity, temperature };
 }
 
-auto device::read_data() -> std::bitset<response_bitcount> {
-  // https://github.com/torvalds/linux/blob/master/tools/gpio/gpio-event-mon.c
+auto device::decode_bits(const std::vector<event_data>& frame)
+    -> std::bitset<response_bitcount> {
   using namespace std::chrono_literals;
-  //  auto low = event_request::falling_edge;
-  //  auto high = event_request::rising_edge;
+  // HIGH of 26-28µs is a 0, 70µs is a 1
+  constexpr auto one_threshold = 48us;
+
+  // The frame may start with the line being released by the host and may
+  // be missing the preamble, so the bits are located from the closing LOW,
+  // dropping the release that ends it if it was captured
+  auto last = frame.end();
+  if (!frame.empty() && frame.back().type == event_type::rising_edge) last--;
+
+  constexpr auto bit_edges = 2 * response_bitcount;
+  if (last - frame.begin() < bit_edges + 1) {
+    throw frame_error{ frame_error::reason::missing_edge,
+                       frame.size(),
+                       "response frame is too short to decode" };
+  }
 
-  std::bitset<response_bitcount> data;
-  std::cout << "Initiating communication...\n"
-            << static_cast<int>(handle.listen().type);
-  //
-  //  // Communication starts at HIGH
-  //  handle.write(1);
-  //  std::this_thread::sleep_for(5ms);
-  //
-  //  // Host pulls LOW for 1ms minimum
-  //  handle.write(0);
-  //  std::this_thread::sleep_for(5ms);
-  //  // Host pulls HIGH for 20-40µs
-  //  handle.write(1);
-  //  // Sensor pulls LOW for 80µs
-  //  auto a = handle.listen(low);
-  //  // if listen() blocks for >40µs, no sensor was found;
-  //
-  //  // Sensor pulls HIGH for 80µs
-  //  auto b = handle.listen(high);
-  //
-  //  // Next it will send 40 bits of Data. Each bit starts with a 50µs LOW
-  //  followed
-  //  // by HIGH for 26-28µs for a “0” or for 70µs for a “1”.
-  //  // i. wait for low (falling edge)
-  //  a = handle.listen(event_request::falling_edge);
-  //  for (int i = 0; i < response_bitcount; i++) {
-  //    // ii.  wait for high (rising edge)
-  //    b = handle.listen(event_request::rising_edge);
-  //    // iii. verify time between ii and i (or iv) is 50µs
-  //    // iv.  wait for low (falling edge)
-  //    a = handle.listen(event_request::falling_edge);
-  //    // v.   time between iv and ii determines bit.
-  //    auto duration = a.timestamp - b.timestamp;
-  //    if (duration < 75us && duration > 65us) {
-  //      data.set(i);
-  //    }
-  //  }
+  // Each bit starts with a 50µs LOW followed by a HIGH whose length is the
+  // value, the last HIGH is terminated by the closing LOW pulse.
+  auto bits = last - (bit_edges + 1);
+  if (bits->type != event_type::falling_edge) {
+    throw frame_error{ frame_error::reason::missing_edge,
+                       frame.size(),
+                       "response does not start with a falling edge" };
+  }
 
-  // After communication ends, the Line is pulled HIGH by the pull-up resistor
-  // and enters IDLE state.
+  std::bitset<response_bitcount> data;
+  for (size_t i = 0; i < response_bitcount; i++) {
+    auto high = bits[2 * i + 2].timestamp - bits[2 * i + 1].timestamp;
+    data[i]   = high > one_threshold;
+  }
   return data;
 }
 
@@ -0,0 +1,392 @@
+#include <dht/event_loop.hpp>
+#include <dht/gpio.hpp>
+
+#include "uring.hpp"
+
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dht {
+
+struct event_loop::loop_backend {
+  loop_backend() {
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd == -1) {
+      throw std::runtime_error("eventfd() failed: "
+                               + std::string(std::strerror(errno)));
+    }
+  }
+
+  loop_backend(const loop_backend&) = delete;
+  auto operator=(const loop_backend&) -> loop_backend& = delete;
+
+  virtual ~loop_backend() {
+    close(wake_fd);
+  }
+
+  virtual void add(size_t line, int fd) = 0;
+  virtual void wait(std::vector<line_event>&  events,
+                    std::chrono::milliseconds timeout) = 0;
+
+  void notify() noexcept {
+    uint64_t one = 1;
+    // Only fails if the counter is about to overflow, a wakeup is pending
+    [[maybe_unused]] auto ret = ::write(wake_fd, &one, sizeof(one));
+  }
+
+ protected:
+  int wake_fd = -1;
+};
+
+namespace {
+
+// Events read per line and syscall
+constexpr size_t event_batch = 16;
+using event_buffer           = std::array<gpio_v2_line_event, event_batch>;
+
+void append_events(std::vector<line_event>& events,
+                   size_t                   line,
+                   const event_buffer&      buffer,
+                   size_t                   bytes) {
+  auto n = std::min(bytes / sizeof(gpio_v2_line_event), buffer.size());
+  for (size_t i = 0; i < n; i++) {
+    events.push_back({ line, to_event_data(buffer[i]) });
+  }
+}
+
+auto errno_string() -> std::string {
+  return std::strerror(errno);
+}
+
+struct epoll_backend final : event_loop::loop_backend {
+  explicit epoll_backend(uint32_t max_lines) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+      throw std::runtime_error("epoll_create1() failed: " + errno_string());
+    }
+    fds.reserve(max_lines);
+
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.u64 = wake_tag;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) == -1) {
+      close(epoll_fd);
+      throw std::runtime_error("epoll_ctl() failed: " + errno_string());
+    }
+  }
+
+  ~epoll_backend() override {
+    close(epoll_fd);
+  }
+
+  epoll_backend(const epoll_backend&) = delete;
+  auto operator=(const epoll_backend&) -> epoll_backend& = delete;
+
+  void add(size_t line, int fd) override {
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.u64 = line;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      throw std::runtime_error("epoll_ctl() failed: " + errno_string());
+    }
+    fds.push_back(fd);
+  }
+
+  void wait(std::vector<line_event>&  events,
+            std::chrono::milliseconds timeout) override {
+    using namespace std::chrono;
+    std::array<epoll_event, 64> ready{};
+
+    auto deadline = steady_clock::now() + timeout;
+    auto n        = 0;
+    do {
+      // Rounded up, epoll_wait() must not return before the deadline
+      auto remaining =
+          ceil<milliseconds>(deadline - steady_clock::now()).count();
+      n = epoll_wait(epoll_fd,
+                     ready.data(),
+                     static_cast<int>(ready.size()),
+                     static_cast<int>(std::max<int64_t>(remaining, 0)));
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+      throw std::runtime_error("epoll_wait() failed: " + errno_string());
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (ready[i].data.u64 == wake_tag) {
+        uint64_t count = 0;
+        [[maybe_unused]] auto ret = read(wake_fd, &count, sizeof(count));
+        continue;
+      }
+
+      auto line = static_cast<size_t>(ready[i].data.u64);
+      auto ret  = read(fds[line], buffer.data(), sizeof(buffer));
+      if (ret == -1) {
+        if (errno == EAGAIN || errno == EINTR) continue;
+        throw std::runtime_error("event_loop failed to read data: "
+                                 + errno_string());
+      }
+      append_events(events, line, buffer, static_cast<size_t>(ret));
+    }
+  }
+
+ private:
+  constexpr static uint64_t wake_tag = ~uint64_t{ 0 };
+
+  int              epoll_fd = -1;
+  std::vector<int> fds;
+  event_buffer     buffer{};
+};
+
+#ifdef DHT_HAVE_IO_URING
+
+struct uring_backend final : event_loop::loop_backend {
+  // One read per line and the wakeup, plus the timeout of the current wait
+  explicit uring_backend(uint32_t max_lines) : ring(max_lines + 2) {
+    buffers.resize(max_lines);
+    iovecs.resize(max_lines);
+    fds.reserve(max_lines);
+    post_wake_read();
+  }
+
+  uring_backend(const uring_backend&) = delete;
+  auto operator=(const uring_backend&) -> uring_backend& = delete;
+
+  // Every line and the wakeup always have a read in flight, writing into
+  // buffers and wake_count. Cancel and reap them before those are freed.
+  ~uring_backend() override {
+    auto reads = fds.size() + 1;
+
+    // Queued reads must reach the kernel before they can be cancelled
+    if (ring.enter(0) == -1) return;
+    for (size_t line = 0; line < fds.size(); line++) post_cancel(line);
+    post_cancel(wake_tag);
+
+    while (reads > 0) {
+      if (ring.enter(1) == -1 && errno != EINTR) return;
+      ring.reap([&](const io_uring_cqe& cqe) {
+        auto tag = cqe.user_data;
+        if (tag == wake_tag || tag < fds.size()) reads--;
+      });
+    }
+  }
+
+  void add(size_t line, int fd) override {
+    fds.push_back(fd);
+    iovecs[line] = { buffers[line].data(), sizeof(event_buffer) };
+    post_read(line);
+  }
+
+  void wait(std::vector<line_event>&  events,
+            std::chrono::milliseconds timeout) override {
+    using clock = std::chrono::steady_clock;
+    auto before = events.size();
+
+    // Completions reaped here were posted after the previous wait returned,
+    // a timeout still armed from it is stale from now on
+    armed = false;
+    woken = false;
+    reap(events);
+    if (woken || events.size() != before) return;
+
+    auto until = clock::now() + timeout;
+    while (true) {
+      if (!armed) {
+        auto left = until - clock::now();
+        if (left <= clock::duration::zero()) return;
+        arm_timeout(left);
+      }
+
+      if (ring.enter(1) == -1 && errno != EINTR) {
+        throw std::runtime_error("io_uring_enter() failed: "
+                                 + errno_string());
+      }
+
+      reap(events);
+      if (expired || woken || events.size() != before) return;
+    }
+  }
+
+ private:
+  constexpr static uint64_t timeout_tag = uint64_t{ 1 } << 63U;
+  constexpr static uint64_t wake_tag    = uint64_t{ 1 } << 62U;
+  constexpr static uint64_t cancel_tag  = uint64_t{ 1 } << 61U;
+
+  /**
+   * Completes as soon as any other request does, or with -ETIME once left
+   * has passed. Completions without events, such as stale timeouts or
+   * interrupted reads, disarm it before the deadline.
+   */
+  void arm_timeout(std::chrono::nanoseconds left) {
+    generation++;
+    armed    = true;
+    expired  = false;
+    deadline = detail::to_kernel_timespec(left);
+
+    auto* sqe      = ring.next_sqe();
+    sqe->opcode    = IORING_OP_TIMEOUT;
+    sqe->addr      = reinterpret_cast<uintptr_t>(&deadline);
+    sqe->len       = 1;
+    sqe->off       = 1;
+    sqe->user_data = timeout_tag | generation;
+  }
+
+  void post_read(size_t line) {
+    auto* sqe      = ring.next_sqe();
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = fds[line];
+    sqe->addr      = reinterpret_cast<uintptr_t>(&iovecs[line]);
+    sqe->len       = 1;
+    sqe->user_data = line;
+  }
+
+  void post_cancel(uint64_t tag) {
+    auto* sqe      = ring.next_sqe();
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = tag;
+    sqe->user_data = cancel_tag;
+  }
+
+  void post_wake_read() {
+    wake_iovec     = { &wake_count, sizeof(wake_count) };
+    auto* sqe      = ring.next_sqe();
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = wake_fd;
+    sqe->addr      = reinterpret_cast<uintptr_t>(&wake_iovec);
+    sqe->len       = 1;
+    sqe->user_data = wake_tag;
+  }
+
+  /**
+   * Consumes all completions, re-arming every finished read and tracking
+   * the timeout of the current wait.
+   */
+  void reap(std::vector<line_event>& events) {
+    ring.reap([&](const io_uring_cqe& cqe) {
+      if (cqe.user_data == wake_tag) {
+        woken = true;
+        post_wake_read();
+        return;
+      }
+
+      if ((cqe.user_data & timeout_tag) != 0) {
+        // Timeouts left over from earlier waits are ignored
+        if (cqe.user_data != (timeout_tag | generation)) return;
+        armed   = false;
+        expired = cqe.res == -ETIME;
+        return;
+      }
+
+      auto line = static_cast<size_t>(cqe.user_data);
+      if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN) {
+        throw std::runtime_error("event_loop failed to read data: "
+                                 + std::string(std::strerror(-cqe.res)));
+      }
+
+      if (cqe.res > 0) {
+        append_events(
+            events, line, buffers[line], static_cast<size_t>(cqe.res));
+      }
+      post_read(line);
+    });
+  }
+
+  uint64_t                  generation = 0;
+  bool                      armed      = false;
+  bool                      expired    = false;
+  bool                      woken      = false;
+  uint64_t                  wake_count = 0;
+  iovec                     wake_iovec{};
+  __kernel_timespec         deadline{};
+  std::vector<int>          fds;
+  std::vector<event_buffer> buffers;
+  std::vector<iovec>        iovecs;
+
+  // The ring holds one entry per line, the wakeup and the timeout, and
+  // every wait submits what has been queued, so the queue cannot overflow.
+  // Declared last so it is closed before the memory its reads target goes,
+  // should the destructor fail to reap them.
+  detail::uring ring;
+};
+
+#endif  // DHT_HAVE_IO_URING
+
+auto make_backend(event_backend& kind, uint32_t max_lines)
+    -> std::unique_ptr<event_loop::loop_backend> {
+#ifdef DHT_HAVE_IO_URING
+  if (kind != event_backend::epoll) {
+    try {
+      auto backend = std::make_unique<uring_backend>(max_lines);
+      kind         = event_backend::io_uring;
+      return backend;
+    } catch (const std::runtime_error&) {
+      if (kind == event_backend::io_uring) throw;
+    }
+  }
+#else
+  if (kind == event_backend::io_uring) {
+    throw std::runtime_error("libdht was built without io_uring support");
+  }
+#endif
+  kind = event_backend::epoll;
+  return std::make_unique<epoll_backend>(max_lines);
+}
+
+}  // namespace
+
+event_loop::event_loop(event_backend backend, uint32_t max_lines)
+    : kind(backend), max_lines(max_lines) {
+  impl = make_backend(kind, max_lines);
+}
+
+event_loop::~event_loop() noexcept = default;
+event_loop::event_loop(event_loop&& old) noexcept = default;
+auto event_loop::operator=(event_loop&& rhs) noexcept
+    -> event_loop& = default;
+
+auto event_loop::add(gpio_handle& handle, event_request event) -> size_t {
+  if (lines == max_lines) {
+    throw std::runtime_error("event_loop is full: "
+                             + std::to_string(max_lines) + " lines");
+  }
+  impl->add(lines, handle.event_fd(event));
+  return lines++;
+}
+
+auto event_loop::wait(std::vector<line_event>&  events,
+                      std::chrono::milliseconds timeout) -> size_t {
+  auto before = events.size();
+  impl->wait(events, timeout);
+  return events.size() - before;
+}
+
+void event_loop::notify() noexcept {
+  if (impl) impl->notify();
+}
+
+auto event_loop::backend() const noexcept -> event_backend {
+  return kind;
+}
+
+auto event_loop::size() const noexcept -> size_t {
+  return lines;
+}
+
+}  // namespace dht
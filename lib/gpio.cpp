@@ -1,4 +1,7 @@
 #include <dht/gpio.hpp>
+#include <dht/trace.hpp>
+
+#include "uring.hpp"
 
 #include <fcntl.h>
 #include <linux/gpio.h>
@@ -10,13 +13,15 @@
 #include <array>
 #include <cerrno>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
 // silence IWYU
 using __u8  = uint8_t;
@@ -24,6 +29,21 @@ using __u32 = uint32_t;
 
 namespace dht {
 
+namespace {
+
+// Large enough to hold a whole DHT frame of 84 edges
+constexpr uint32_t event_buffer_size = 128;
+
+auto edge_flags(event_request event) -> uint64_t {
+  switch (event) {
+  case event_request::rising_edge: return GPIO_V2_LINE_FLAG_EDGE_RISING;
+  case event_request::falling_edge: return GPIO_V2_LINE_FLAG_EDGE_FALLING;
+  default:
+    return GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+  }
+}
+
+}  // namespace
 
 gpio_handle::gpio_handle(uint32_t pin, const std::string& chip)
     : gpio_handle(default_label, pin, chip) {
@@ -57,77 +77,73 @@ void gpio_handle::try_close(int& fd) {
   if (fd < 1) return;
   auto err = close(fd);
   if (err == -1) {
-    std::perror("try_close(): failed to close file descriptor");
+    trace(trace_kind::close_failed, fd, errno);
   }
 }
 
-void gpio_handle::set_input(event_request event) {
-  gpioevent_request req{};
+void gpio_handle::configure(const gpio_v2_line_config& config) {
+  if (gpio_fd != -1) {
+    // Reconfiguring in place keeps the line and its file descriptor
+    auto update = config;
+    if (ioctl(gpio_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &update) == -1) {
+      std::string error = std::strerror(errno);
+      throw std::runtime_error("unable to reconfigure line: " + error);
+    }
+    return;
+  }
+
+  gpio_v2_line_request req{};
 
-  req.lineoffset  = pin;
-  req.eventflags  = static_cast<uint32_t>(event);
-  req.handleflags = static_cast<uint32_t>(direction::input);
+  req.offsets[0]        = pin;
+  req.num_lines         = 1;
+  req.config            = config;
+  req.event_buffer_size = event_buffer_size;
 
-  auto n = std::min(label.size(), sizeof(req.consumer_label));
-  std::copy_n(label.begin(), n, req.consumer_label);
+  auto n = std::min(label.size(), sizeof(req.consumer));
+  std::copy_n(label.begin(), n, req.consumer);
 
-  auto ret = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+  auto ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
   if (ret == -1) {
     std::string error = std::strerror(errno);
-    throw std::runtime_error("set_input(): unable to issue get line event: "
-                             + error);
+    throw std::runtime_error("unable to issue get line: " + error);
   }
 
   if (req.fd < 1) {
     throw std::runtime_error(
-        "get line event returned invalid gpio file descriptor");
+        "get line returned invalid gpio file descriptor");
   }
 
-  try_close(gpio_fd);
-
-  gpio_fd        = req.fd;
-  port_direction = direction::input;
+  gpio_fd = req.fd;
 }
 
-auto gpio_handle::listen(event_request event, std::chrono::milliseconds timeout)
-    -> event_data {
-  if (port_direction != direction::input) {
-    set_input(event);
-  }
-
-  std::array fds = { pollfd{
-      gpio_fd,
-      POLLIN,
-  } };
-
-  auto ret = poll(fds.begin(), 1, timeout.count());
-  auto& pollobj = fds[0];
-
-  if (ret == -1) {
-    std::string err = std::strerror(errno);
-    throw std::runtime_error("poll() returned -1: " + err);
-  }
+void gpio_handle::set_input(event_request event) {
+  gpio_v2_line_config config{};
+  config.flags = GPIO_V2_LINE_FLAG_INPUT | edge_flags(event);
 
-  if (ret == 0) {
-    throw timeout_exceeded{ *this, event, timeout };
-  }
+  configure(config);
+  port_direction = direction::input;
+}
 
-  if (ret != 1) {
-    throw std::runtime_error("unknown exception occured in listen");
-  }
+void gpio_handle::discard_events() {
+  std::array<gpio_v2_line_event, 16> buffer{};
 
-  if ((pollobj.revents & POLLERR) == POLLERR) {
-    std::string err = std::strerror(errno);
-    throw std::runtime_error("POLLERR returned from poll(): " + err);
+  // An event_loop may have a read pending on the fd that takes the last
+  // events first, so a blocking read could wait for edges that, with the
+  // line an output, never come. O_NONBLOCK is only set for the drain, as
+  // io_uring fails reads on non-blocking fds instead of polling.
+  auto flags = fcntl(gpio_fd, F_GETFL);
+  if (flags == -1 || fcntl(gpio_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    return;
   }
-
-  if ((pollobj.revents & POLLIN) != POLLIN) {
-    throw std::runtime_error("poll() returned without any readable data: "
-                             + std::to_string(pollobj.revents));
+  while (read(gpio_fd, buffer.data(), sizeof(buffer)) > 0) {
   }
+  fcntl(gpio_fd, F_SETFL, flags);
+}
 
-  gpioevent_data data;
-  ret = read(gpio_fd, &data, sizeof(data));
+auto gpio_handle::listen(event_request event, std::chrono::milliseconds timeout)
+    -> event_data {
+  gpio_v2_line_event data;
+  auto ret = detail::read_for(event_fd(event), &data, sizeof(data), timeout);
 
   if (ret == -1) {
     using namespace std::string_literals;
@@ -135,6 +151,11 @@ auto gpio_handle::listen(event_request event, std::chrono::milliseconds timeout)
                              + std::strerror(errno));
   }
 
+  if (ret == 0) {
+    trace(trace_kind::timeout, pin, timeout.count());
+    throw timeout_exceeded{ *this, event, timeout };
+  }
+
   if (ret != sizeof(data)) {
     std::ostringstream ss;
     ss << "reading event data failed. Read " << ret << ", expected "
@@ -142,32 +163,84 @@ auto gpio_handle::listen(event_request event, std::chrono::milliseconds timeout)
     throw std::runtime_error(ss.str());
   }
 
-  return { std::chrono::steady_clock::time_point{
-               std::chrono::nanoseconds{ data.timestamp } },
-           static_cast<event_type>(data.id) };
+  return to_event_data(data);
 }
 
-void gpio_handle::set_output(bool value) {
-  gpiohandle_request req{};
-
-  req.lines             = 1;
-  req.lineoffsets[0]    = pin;
-  req.default_values[0] = static_cast<uint8_t>(value);
-  req.flags             = static_cast<uint32_t>(direction::output);
-
-  auto n = std::min(label.size(), sizeof(req.consumer_label));
-  std::copy_n(label.begin(), n, req.consumer_label);
-
-  auto ret = ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
-  if (ret == -1) {
-    std::string err = std::strerror(errno);
-    throw std::runtime_error("set_output(): unable to get line handle: " + err);
+void gpio_handle::capture(std::vector<event_data>&  frame,
+                          size_t                    count,
+                          std::chrono::microseconds deadline,
+                          event_request             event) {
+  using clock = std::chrono::steady_clock;
+
+  auto fd    = event_fd(event);
+  auto until = clock::now() + deadline;
+
+  frame.clear();
+  frame.reserve(count);
+
+  std::array<gpio_v2_line_event, 16> buffer{};
+  while (frame.size() < count) {
+    // Edges already buffered by the kernel are read even past the deadline
+    auto left      = std::max(until - clock::now(), clock::duration::zero());
+    auto remaining = std::chrono::nanoseconds{ left }.count();
+    timespec timeout{ static_cast<time_t>(remaining / 1000000000),
+                      static_cast<long>(remaining % 1000000000) };
+
+    pollfd pollobj{ fd, POLLIN, 0 };
+    auto   ret = ppoll(&pollobj, 1, &timeout, nullptr);
+    if (ret == -1) {
+      if (errno == EINTR) continue;
+      std::string err = std::strerror(errno);
+      throw std::runtime_error("ppoll() returned -1: " + err);
+    }
+
+    if (ret == 0) {
+      throw frame_error{ frame_error::reason::deadline_exceeded,
+                         frame.size(),
+                         "frame deadline exceeded after "
+                             + std::to_string(frame.size()) + " of "
+                             + std::to_string(count) + " edges" };
+    }
+
+    // Never read past the frame, later edges stay queued in the kernel
+    auto wanted = std::min(buffer.size(), count - frame.size());
+    auto bytes  = read(fd, buffer.data(), wanted * sizeof(buffer[0]));
+    if (bytes == -1) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      using namespace std::string_literals;
+      throw std::runtime_error("capture() failed to read data: "s
+                               + std::strerror(errno));
+    }
+
+    auto n = static_cast<size_t>(bytes) / sizeof(buffer[0]);
+    for (size_t i = 0; i < n; i++) {
+      append_edge(frame, to_event_data(buffer[i]), event);
+    }
   }
+}
 
-  try_close(gpio_fd);
+auto gpio_handle::event_fd(event_request event) -> int {
+  if (port_direction != direction::input) {
+    set_input(event);
+  }
+  return gpio_fd;
+}
 
-  gpio_fd        = req.fd;
+void gpio_handle::set_output(bool value) {
+  gpio_v2_line_config config{};
+  config.flags                = GPIO_V2_LINE_FLAG_OUTPUT;
+  config.num_attrs            = 1;
+  config.attrs[0].attr.id     = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+  config.attrs[0].attr.values = static_cast<uint64_t>(value);
+  config.attrs[0].mask        = 1;
+
+  auto was_input = port_direction == direction::input;
+  configure(config);
   port_direction = direction::output;
+
+  // Edges queued but never read while listening would otherwise be taken
+  // for the start of the next frame
+  if (was_input) discard_events();
 }
 
 auto gpio_handle::write(int value) -> void {
@@ -177,13 +250,14 @@ auto gpio_handle::write(int value) -> void {
 auto gpio_handle::write(bool value) -> void {
   if (port_direction != direction::output) {
     set_output(value);
+    return;
   }
 
-  gpiohandle_data data{};
+  gpio_v2_line_values values{};
+  values.bits = static_cast<uint64_t>(value);
+  values.mask = 1;
 
-  data.values[0] = static_cast<uint32_t>(value);
-
-  auto ret = ioctl(gpio_fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+  auto ret = ioctl(gpio_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
   if (ret == -1) {
     std::string err = std::strerror(errno);
     throw std::runtime_error("write(): unable to set line values: " + err);
@@ -204,6 +278,41 @@ void swap(gpio_handle& a, gpio_handle& b) noexcept {
 }
 
 
+auto to_event_data(const gpio_v2_line_event& event) noexcept -> event_data {
+  return { std::chrono::steady_clock::time_point{
+               std::chrono::nanoseconds{ event.timestamp_ns } },
+           static_cast<event_type>(event.id),
+           event.line_seqno };
+}
+
+void append_edge(std::vector<event_data>& frame,
+                 const event_data&        edge,
+                 event_request            event) {
+  if (!frame.empty() && edge.sequence != frame.back().sequence + 1) {
+    auto lost = edge.sequence - frame.back().sequence - 1;
+    throw frame_error{ frame_error::reason::sequence_gap,
+                       frame.size(),
+                       "lost " + std::to_string(lost) + " events after edge "
+                           + std::to_string(frame.size()) };
+  }
+
+  if (event == event_request::any && !frame.empty()
+      && edge.type == frame.back().type) {
+    throw frame_error{ frame_error::reason::missing_edge,
+                       frame.size(),
+                       "missing edge before edge "
+                           + std::to_string(frame.size()) };
+  }
+
+  frame.push_back(edge);
+}
+
+frame_error::frame_error(reason             why,
+                         size_t             captured,
+                         const std::string& message)
+    : std::runtime_error(message), why(why), captured(captured) {
+}
+
 timeout_exceeded::timeout_exceeded(gpio_handle&              handle,
                                    event_request             requested_event,
                                    std::chrono::milliseconds timeout) noexcept
@@ -0,0 +1,400 @@
+#include <dht/device.hpp>
+#include <dht/event_loop.hpp>
+#include <dht/gpio.hpp>
+#include <dht/poller.hpp>
+#include <dht/sampler.hpp>
+#include <dht/trace.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace dht {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct decoded {
+  size_t                  slot;
+  std::optional<response> reading;
+  std::vector<event_data> frame;  // handed back for the next capture
+};
+
+void pin_to_core(size_t index) {
+  auto      cores = std::max(1U, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(index % cores, &set);
+  // Best effort, an unpinned worker still works
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+}  // namespace
+
+struct poller::worker {
+  std::mutex           m;  // guards results
+  std::vector<decoded> results;
+  std::vector<size_t>  sensors;
+  event_loop*          loop = nullptr;  // set between the barriers of run()
+  std::thread          thread;
+};
+
+auto shard_sensors(const std::vector<sensor_location>& sensors, size_t workers)
+    -> std::vector<size_t> {
+  if (workers == 0) {
+    throw std::invalid_argument("shard_sensors() needs at least one worker");
+  }
+
+  std::vector<size_t> order(sensors.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+    return std::tie(sensors[a].chip, sensors[a].pin)
+           < std::tie(sensors[b].chip, sensors[b].pin);
+  });
+
+  // Spread the remainder over the first workers
+  std::vector<size_t> shard(sensors.size());
+  auto                per   = sensors.size() / workers;
+  auto                extra = sensors.size() % workers;
+  size_t              next  = 0;
+  for (size_t w = 0; w < workers; w++) {
+    auto count = per + (w < extra ? 1 : 0);
+    for (size_t i = 0; i < count; i++) {
+      shard[order[next++]] = w;
+    }
+  }
+  return shard;
+}
+
+capture_cycle::capture_cycle(const sampling_policy& policy,
+                             clock_type::time_point now)
+    : schedule(policy), next(now) {
+  edges.reserve(device::frame_edges);
+}
+
+auto capture_cycle::step(clock_type::time_point now) -> std::optional<phase> {
+  if (current == phase::decoding || now < next) return std::nullopt;
+
+  switch (current) {
+  case phase::idle:
+    current = phase::signalling;
+    next    = now + device::start_signal;
+    break;
+  case phase::signalling:
+    edges.clear();
+    released = now;
+    current  = phase::capturing;
+    next     = now + device::frame_deadline;
+    break;
+  case phase::capturing:
+    // Switching to input may miss the preamble, the data is all that counts
+    if (edges.size() < device::data_edges) {
+      retry(now);
+      throw frame_error{ frame_error::reason::deadline_exceeded,
+                         edges.size(),
+                         "frame deadline exceeded after "
+                             + std::to_string(edges.size()) + " edges" };
+    }
+    current = phase::decoding;
+    break;
+  case phase::decoding: break;
+  }
+  return current;
+}
+
+auto capture_cycle::edge(const event_data& event, clock_type::time_point now)
+    -> bool {
+  // Edges from before the line was released are not part of the frame
+  if (current != phase::capturing || event.timestamp < released) return false;
+
+  try {
+    append_edge(edges, event);
+  } catch (const frame_error&) {
+    retry(now);
+    throw;
+  }
+
+  if (edges.size() < device::frame_edges) return false;
+  current = phase::decoding;
+  return true;
+}
+
+void capture_cycle::finish(const std::optional<response>& reading) {
+  current = phase::idle;
+  next    = released + (reading ? schedule.update(*reading) : schedule.reset());
+}
+
+void capture_cycle::retry(clock_type::time_point now) {
+  current = phase::idle;
+  next    = now + schedule.reset();
+}
+
+auto capture_cycle::frame() noexcept -> std::vector<event_data>& {
+  return edges;
+}
+
+auto capture_cycle::state() const noexcept -> phase {
+  return current;
+}
+
+auto capture_cycle::due() const noexcept -> clock_type::time_point {
+  return current == phase::decoding ? clock_type::time_point::max() : next;
+}
+
+poller::poller(callback publish, poller_options options)
+    : publish(std::move(publish)), options(std::move(options)) {
+}
+
+poller::~poller() noexcept {
+  stop();
+}
+
+auto poller::add(uint32_t pin, const std::string& chip) -> size_t {
+  if (!pool.empty()) {
+    throw std::logic_error("poller::add() called after start()");
+  }
+  sensors.push_back({ chip, pin });
+  return sensors.size() - 1;
+}
+
+void poller::start() {
+  if (!pool.empty()) {
+    throw std::logic_error("poller::start() called twice");
+  }
+
+  auto n = options.workers != 0
+               ? options.workers
+               : std::max<size_t>(1, std::thread::hardware_concurrency());
+  auto shard = shard_sensors(sensors, n);
+
+  for (size_t i = 0; i < n; i++) {
+    pool.push_back(std::make_unique<worker>());
+  }
+  for (size_t sensor = 0; sensor < sensors.size(); sensor++) {
+    pool[shard[sensor]]->sensors.push_back(sensor);
+  }
+  queues = std::make_unique<work_queues<job>>(n);
+
+  ready         = 0;
+  exited        = 0;
+  startup_error = nullptr;
+  running       = true;
+  for (size_t i = 0; i < n; i++) {
+    pool[i]->thread = std::thread(&poller::run, this, i);
+  }
+
+  std::unique_lock lock(wake_mutex);
+  wake.wait(lock, [&] { return ready == n; });
+  if (startup_error) {
+    auto error = startup_error;
+    lock.unlock();
+    stop();
+    std::rethrow_exception(error);
+  }
+}
+
+void poller::stop() noexcept {
+  {
+    std::scoped_lock lock(wake_mutex);
+    running = false;
+    for (auto& w: pool) {
+      if (w->loop != nullptr) w->loop->notify();
+    }
+  }
+  wake.notify_all();
+
+  for (auto& w: pool) {
+    if (w->thread.joinable()) w->thread.join();
+  }
+  pool.clear();
+  queues.reset();
+}
+
+auto poller::workers() const noexcept -> size_t {
+  return pool.size();
+}
+
+auto poller::size() const noexcept -> size_t {
+  return sensors.size();
+}
+
+void poller::run(size_t index) {
+  using phase = capture_cycle::phase;
+
+  struct slot {
+    gpio_handle   handle;
+    size_t        sensor;
+    capture_cycle cycle;
+  };
+
+  auto& self = *pool[index];
+  if (options.pin_workers) pin_to_core(index);
+
+  // Lines, and with them their chip fds, live and die on this thread. They
+  // are declared first to outlive the event_loop they are registered in.
+  std::vector<slot>         slots;
+  std::optional<event_loop> loop;
+  try {
+    auto lines = std::max<size_t>(1, self.sensors.size());
+    loop.emplace(options.backend, static_cast<uint32_t>(lines));
+
+    // The index of a slot is the line index of its events
+    slots.reserve(self.sensors.size());
+    auto now = clock_type::now();
+    for (auto sensor: self.sensors) {
+      const auto& location = sensors[sensor];
+      slots.push_back({ gpio_handle{ location.pin, location.chip },
+                        sensor,
+                        capture_cycle{ options.policy, now } });
+      loop->add(slots.back().handle);
+    }
+  } catch (...) {
+    std::scoped_lock lock(wake_mutex);
+    if (!startup_error) startup_error = std::current_exception();
+    loop.reset();
+  }
+
+  // No worker is woken before every loop is in place
+  {
+    std::unique_lock lock(wake_mutex);
+    if (loop) self.loop = &*loop;
+    ready++;
+    wake.notify_all();
+    wake.wait(lock, [&] { return ready == pool.size() || !running; });
+  }
+
+  auto fail = [&](const slot& s, const frame_error& e) {
+    trace(trace_kind::frame_error,
+          sensors[s.sensor].pin,
+          static_cast<uint32_t>(e.why),
+          e.captured);
+  };
+
+  // The frame is swapped into the job, the slot gets it back with the result
+  auto complete = [&](size_t i, slot& s) {
+    auto pin = sensors[s.sensor].pin;
+    trace(trace_kind::edge_count, pin, s.cycle.frame().size());
+    trace(trace_kind::frame_end, pin);
+    job next{ s.sensor, index, i, {} };
+    next.frame.swap(s.cycle.frame());
+    queue_job(index, std::move(next));
+  };
+
+  auto step = [&](size_t i, slot& s, clock_type::time_point now) {
+    try {
+      auto entered = s.cycle.step(now);
+      if (!entered) return;
+      switch (*entered) {
+      case phase::signalling:
+        trace(trace_kind::frame_start, sensors[s.sensor].pin);
+        s.handle.write(false);
+        break;
+      case phase::capturing:
+        // Released to the pull-up, the sensor answers 20-40µs later
+        s.handle.event_fd();
+        break;
+      case phase::decoding: complete(i, s); break;
+      case phase::idle: break;
+      }
+    } catch (const frame_error& e) {
+      fail(s, e);
+    } catch (const std::runtime_error&) {
+      // The line could not be switched, retry at the minimum interval
+      s.cycle.retry(now);
+    }
+  };
+
+  // A worker that failed to start only waits for stop()
+  std::vector<decoded>    results;
+  std::vector<line_event> events;
+  while (running && loop) {
+    // Readings decoded by any worker reschedule their sensor here
+    {
+      std::scoped_lock lock(self.m);
+      results.swap(self.results);
+    }
+    for (auto& result: results) {
+      auto& cycle = slots[result.slot].cycle;
+      cycle.frame().swap(result.frame);
+      cycle.finish(result.reading);
+    }
+    results.clear();
+
+    auto now = clock_type::now();
+    for (size_t i = 0; i < slots.size(); i++) step(i, slots[i], now);
+
+    if (next_job(index)) continue;
+
+    auto until = now + options.policy.min_interval;
+    for (const auto& s: slots) until = std::min(until, s.cycle.due());
+
+    if (!queues->park(index)) continue;
+    events.clear();
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        until - clock_type::now());
+    loop->wait(events, std::max(left, std::chrono::milliseconds::zero()));
+    queues->unpark(index);
+
+    now = clock_type::now();
+    for (const auto& e: events) {
+      auto& s = slots[e.line];
+      try {
+        if (s.cycle.edge(e.event, now)) complete(e.line, s);
+      } catch (const frame_error& error) {
+        fail(s, error);
+      }
+    }
+  }
+
+  // Other workers may deliver results until they left their loops too
+  std::unique_lock lock(wake_mutex);
+  exited++;
+  wake.notify_all();
+  wake.wait(lock, [&] { return exited == pool.size(); });
+  self.loop = nullptr;
+}
+
+void poller::queue_job(size_t index, job next) {
+  // The owner decodes its newest job itself, a backlog goes to a thief
+  if (queues->push(index, std::move(next)) < 2) return;
+  if (auto thief = queues->claim_idle(index)) pool[*thief]->loop->notify();
+}
+
+auto poller::next_job(size_t index) -> bool {
+  auto current = queues->pop(index);
+  if (!current) return false;
+
+  std::optional<response> reading;
+  try {
+    reading = device::decode(current->frame, sensors[current->sensor].pin);
+  } catch (const frame_error&) {
+  }
+
+  if (reading) publish(current->sensor, *reading);
+
+  auto& owner = *pool[current->owner];
+  {
+    std::scoped_lock lock(owner.m);
+    owner.results.push_back(
+        { current->slot, reading, std::move(current->frame) });
+  }
+  if (current->owner != index) owner.loop->notify();
+  return true;
+}
+
+}  // namespace dht
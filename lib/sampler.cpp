@@ -0,0 +1,114 @@
+#include <dht/device.hpp>
+#include <dht/sampler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace dht {
+
+adaptive_interval::adaptive_interval(const sampling_policy& policy)
+    : policy(policy), current(policy.min_interval) {
+  if (policy.min_interval > policy.max_interval) {
+    throw std::invalid_argument(
+        "sampling_policy: min_interval exceeds max_interval");
+  }
+  // Also rejects NaN
+  if (!(policy.backoff >= 1)) {
+    throw std::invalid_argument("sampling_policy: backoff below 1");
+  }
+}
+
+auto adaptive_interval::update(const response& reading) noexcept
+    -> std::chrono::milliseconds {
+  auto stable =
+      has_reference
+      && std::abs(reading.humidity - reference.humidity)
+             <= policy.humidity_delta
+      && std::abs(reading.temperature - reference.temperature)
+             <= policy.temperature_delta;
+
+  if (stable) {
+    // Clamped before converting, a large backoff overflows the count
+    auto grown = std::min(static_cast<double>(current.count()) * policy.backoff,
+                          static_cast<double>(policy.max_interval.count()));
+    current = std::max(
+        std::chrono::milliseconds{ static_cast<int64_t>(grown) },
+        policy.min_interval);
+  } else {
+    current       = policy.min_interval;
+    reference     = reading;
+    has_reference = true;
+  }
+  return current;
+}
+
+auto adaptive_interval::reset() noexcept -> std::chrono::milliseconds {
+  current       = policy.min_interval;
+  has_reference = false;
+  return current;
+}
+
+auto adaptive_interval::interval() const noexcept
+    -> std::chrono::milliseconds {
+  return current;
+}
+
+auto sampler::add(device& unit, const sampling_policy& policy) -> size_t {
+  // A single attempt per poll, poll() would retry checksum errors back to
+  // back regardless of the minimum interval
+  return add(
+      [&unit] {
+        auto reading = unit.read();
+        if (!reading) throw std::runtime_error("checksum mismatch");
+        return *reading;
+      },
+      policy);
+}
+
+auto sampler::add(source poll, const sampling_policy& policy) -> size_t {
+  sensors.push_back({ std::move(poll),
+                      adaptive_interval{ policy },
+                      std::chrono::steady_clock::now() });
+  return sensors.size() - 1;
+}
+
+auto sampler::next() -> sample {
+  if (sensors.empty()) {
+    throw std::logic_error("sampler::next() called without any sensors");
+  }
+
+  auto it = std::min_element(
+      sensors.begin(), sensors.end(), [](const auto& a, const auto& b) {
+        return a.due < b.due;
+      });
+  std::this_thread::sleep_until(it->due);
+
+  auto     now = std::chrono::steady_clock::now();
+  response reading;
+  try {
+    reading = it->poll();
+  } catch (...) {
+    // Retry a failing sensor at the minimum interval rather than in a loop
+    it->due = now + it->schedule.reset();
+    throw;
+  }
+  it->due = now + it->schedule.update(reading);
+
+  return { static_cast<size_t>(it - sensors.begin()), reading, now };
+}
+
+auto sampler::interval(size_t sensor) const -> std::chrono::milliseconds {
+  return sensors.at(sensor).schedule.interval();
+}
+
+auto sampler::size() const noexcept -> size_t {
+  return sensors.size();
+}
+
+}  // namespace dht
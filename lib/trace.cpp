@@ -0,0 +1,19 @@
+#include <dht/trace.hpp>
+
+#include <atomic>
+
+namespace dht {
+
+namespace detail {
+std::atomic<trace_sink*> active_sink{ nullptr };
+}  // namespace detail
+
+void set_trace_sink(trace_sink* sink) noexcept {
+  detail::active_sink.store(sink, std::memory_order_release);
+}
+
+auto get_trace_sink() noexcept -> trace_sink* {
+  return detail::active_sink.load(std::memory_order_acquire);
+}
+
+}  // namespace dht
@@ -0,0 +1,239 @@
+#include "uring.hpp"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace dht::detail {
+
+namespace {
+
+auto poll_read_for(int                      fd,
+                   void*                    data,
+                   size_t                   size,
+                   std::chrono::nanoseconds timeout) -> ssize_t {
+  auto    ns = std::max<int64_t>(timeout.count(), 0);
+  timespec left{ static_cast<time_t>(ns / 1000000000),
+                 static_cast<long>(ns % 1000000000) };
+
+  pollfd pollobj{ fd, POLLIN, 0 };
+  auto   ret = ppoll(&pollobj, 1, &left, nullptr);
+  if (ret <= 0) return ret;
+  return read(fd, data, size);
+}
+
+#ifdef DHT_HAVE_IO_URING
+
+auto errno_string() -> std::string {
+  return std::strerror(errno);
+}
+
+constexpr uint64_t read_tag    = 0;
+constexpr uint64_t timeout_tag = 1;
+
+/**
+ * The per-thread ring of read_for(). Reads land in buffer and are copied
+ * out, so a read abandoned after a failed enter can never write into the
+ * caller's memory.
+ */
+struct reader {
+  std::unique_ptr<uring>     ring;
+  bool                       unavailable = false;
+  std::array<std::byte, 256> buffer{};
+};
+
+auto uring_read_for(reader&                  self,
+                    int                      fd,
+                    void*                    data,
+                    size_t                   size,
+                    std::chrono::nanoseconds timeout) -> ssize_t {
+  auto& ring     = *self.ring;
+  iovec vec{ self.buffer.data(), size };
+  auto  deadline = to_kernel_timespec(timeout);
+
+  auto* read      = ring.next_sqe();
+  read->opcode    = IORING_OP_READV;
+  read->flags     = IOSQE_IO_LINK;
+  read->fd        = fd;
+  read->addr      = reinterpret_cast<uintptr_t>(&vec);
+  read->len       = 1;
+  read->user_data = read_tag;
+
+  auto* link      = ring.next_sqe();
+  link->opcode    = IORING_OP_LINK_TIMEOUT;
+  link->addr      = reinterpret_cast<uintptr_t>(&deadline);
+  link->len       = 1;
+  link->user_data = timeout_tag;
+
+  // Both always complete, the loser with -ECANCELED, and are reaped before
+  // returning so the next call starts on an empty ring.
+  ssize_t result  = 0;
+  auto    pending = 2U;
+  while (pending > 0) {
+    if (ring.enter(pending) == -1 && errno != EINTR) {
+      // Completions can no longer be waited for, their tags would be
+      // mistaken for those of the next call. Drop the ring, which cancels
+      // the read, and use ppoll() on this thread from now on.
+      auto error = errno;
+      self.ring.reset();
+      self.unavailable = true;
+      errno            = error;
+      return -1;
+    }
+    ring.reap([&](const io_uring_cqe& cqe) {
+      pending--;
+      if (cqe.user_data == read_tag) result = cqe.res;
+    });
+  }
+
+  if (result == -ECANCELED) return 0;
+  if (result < 0) {
+    errno = -static_cast<int>(result);
+    return -1;
+  }
+  std::memcpy(data, self.buffer.data(), static_cast<size_t>(result));
+  return result;
+}
+
+#endif  // DHT_HAVE_IO_URING
+
+}  // namespace
+
+auto read_for(int fd, void* data, size_t size, std::chrono::nanoseconds timeout)
+    -> ssize_t {
+#ifdef DHT_HAVE_IO_URING
+  // A read and its linked timeout at a time
+  thread_local reader self;
+
+  if (!self.ring && !self.unavailable) {
+    try {
+      self.ring = std::make_unique<uring>(2);
+    } catch (const std::runtime_error&) {
+      self.unavailable = true;
+    }
+  }
+  if (self.ring && size <= self.buffer.size()) {
+    return uring_read_for(self, fd, data, size, timeout);
+  }
+#endif
+  return poll_read_for(fd, data, size, timeout);
+}
+
+#ifdef DHT_HAVE_IO_URING
+
+auto to_kernel_timespec(std::chrono::nanoseconds duration) noexcept
+    -> __kernel_timespec {
+  auto ns = std::max<int64_t>(duration.count(), 0);
+  return { ns / 1000000000, ns % 1000000000 };
+}
+
+uring::uring(unsigned entries) {
+  io_uring_params params{};
+
+  ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (ring_fd == -1) {
+    throw std::runtime_error("io_uring_setup() failed: " + errno_string());
+  }
+
+  try {
+    if ((params.features & IORING_FEAT_FAST_POLL) == 0) {
+      throw std::runtime_error("io_uring lacks IORING_FEAT_FAST_POLL");
+    }
+    map_rings(params);
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+uring::~uring() noexcept {
+  release();
+}
+
+auto uring::next_sqe() -> io_uring_sqe* {
+  auto  index = sq_local & sq_mask;
+  auto* sqe   = &sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array[index] = index;
+  sq_local++;
+  return sqe;
+}
+
+auto uring::enter(unsigned wait) -> int {
+  __atomic_store_n(sq_tail, sq_local, __ATOMIC_RELEASE);
+
+  // Entries left behind by an interrupted enter are submitted again
+  auto pending = sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+  auto flags   = wait > 0 ? IORING_ENTER_GETEVENTS : 0U;
+  auto ret     = syscall(
+      __NR_io_uring_enter, ring_fd, pending, wait, flags, nullptr, 0);
+  return ret == -1 ? -1 : 0;
+}
+
+void uring::map_rings(const io_uring_params& params) {
+  sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_size = cq_size = std::max(sq_size, cq_size);
+  }
+
+  sq_ring = map(sq_size, IORING_OFF_SQ_RING);
+  cq_ring = single_mmap ? sq_ring : map(cq_size, IORING_OFF_CQ_RING);
+
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  sqes      = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+
+  auto* sq = static_cast<char*>(sq_ring);
+  sq_head  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask  = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sq_local = *sq_tail;
+
+  auto* cq = static_cast<char*>(cq_ring);
+  cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask  = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+auto uring::map(size_t size, off_t offset) const -> void* {
+  auto* ptr = mmap(nullptr,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   ring_fd,
+                   offset);
+  if (ptr == MAP_FAILED) {
+    throw std::runtime_error("mmap() of io_uring failed: " + errno_string());
+  }
+  return ptr;
+}
+
+void uring::release() noexcept {
+  // Closing first cancels what is still in flight before the rings go
+  if (ring_fd != -1) close(ring_fd);
+  if (sqes != nullptr) munmap(sqes, sqes_size);
+  if (cq_ring != nullptr && cq_ring != sq_ring) munmap(cq_ring, cq_size);
+  if (sq_ring != nullptr) munmap(sq_ring, sq_size);
+}
+
+#endif  // DHT_HAVE_IO_URING
+
+}  // namespace dht::detail
@@ -0,0 +1,104 @@
+#ifndef DHT_LIB_URING_HPP
+#define DHT_LIB_URING_HPP
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+
+#if !defined(DHT_DISABLE_IO_URING) && __has_include(<linux/io_uring.h>) \
+    && defined(__NR_io_uring_setup)
+#  include <linux/io_uring.h>
+#  ifdef IORING_FEAT_FAST_POLL
+#    define DHT_HAVE_IO_URING
+#  endif
+#endif
+
+namespace dht::detail {
+
+/**
+ * Reads at most size bytes from fd, waiting no longer than timeout. Returns
+ * the number of bytes read, 0 if the timeout expired and -1 with errno set
+ * on failure.
+ *
+ * Uses a per-thread io_uring where the read is linked to its timeout, one
+ * syscall per call, for reads of up to 256 bytes. Falls back to ppoll()
+ * followed by read() otherwise, when io_uring is unavailable, and on the
+ * calling thread for good once the ring failed.
+ */
+auto read_for(int fd, void* data, size_t size, std::chrono::nanoseconds timeout)
+    -> ssize_t;
+
+#ifdef DHT_HAVE_IO_URING
+
+auto to_kernel_timespec(std::chrono::nanoseconds duration) noexcept
+    -> __kernel_timespec;
+
+/**
+ * A submission and completion queue pair driven through raw syscalls.
+ * Throws std::runtime_error if io_uring is unavailable or lacks fast poll,
+ * without which reads on line fds would block kernel worker threads.
+ */
+struct uring {
+  explicit uring(unsigned entries);
+  ~uring() noexcept;
+
+  uring(const uring&) = delete;
+  auto operator=(const uring&) -> uring& = delete;
+
+  /**
+   * Returns a zeroed submission entry, queued until the next enter(). The
+   * caller must not queue more entries than the ring holds between calls.
+   */
+  auto next_sqe() -> io_uring_sqe*;
+
+  /**
+   * Submits all queued entries and waits for at least wait completions.
+   * Returns -1 with errno set on failure, EINTR included.
+   */
+  auto enter(unsigned wait) -> int;
+
+  /**
+   * Consumes every available completion, passing each to fn. A completion
+   * is consumed before fn sees it, so fn may throw.
+   */
+  template <typename Fn>
+  void reap(Fn&& fn) {
+    auto head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      auto cqe = cqes[head & cq_mask];
+      __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+      fn(cqe);
+    }
+  }
+
+ private:
+  void map_rings(const io_uring_params& params);
+  auto map(size_t size, off_t offset) const -> void*;
+  void release() noexcept;
+
+  int           ring_fd   = -1;
+  void*         sq_ring   = nullptr;
+  void*         cq_ring   = nullptr;
+  io_uring_sqe* sqes      = nullptr;
+  size_t        sq_size   = 0;
+  size_t        cq_size   = 0;
+  size_t        sqes_size = 0;
+
+  unsigned*     sq_head  = nullptr;
+  unsigned*     sq_tail  = nullptr;
+  unsigned*     sq_array = nullptr;
+  unsigned      sq_mask  = 0;
+  unsigned      sq_local = 0;
+  unsigned*     cq_head  = nullptr;
+  unsigned*     cq_tail  = nullptr;
+  unsigned      cq_mask  = 0;
+  io_uring_cqe* cqes     = nullptr;
+};
+
+#endif  // DHT_HAVE_IO_URING
+
+}  // namespace dht::detail
+
+#endif  // DHT_LIB_URING_HPP
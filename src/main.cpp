@@ -1,10 +1,23 @@
 #include <dht/device.hpp>
+#include <dht/sampler.hpp>
 
+#include <exception>
 #include <iostream>
 
 int main(int /* argc */, char** /* argv */) {  // NOLINT
-  dht::device dht22{ 2 };
-  for (const auto [humidity, temperature]: dht22) {
-    std::cout << "RH: " << humidity << "%, " << temperature << "C\n";
+  dht::device  dht22{ 2 };
+  dht::sampler sampler;
+  sampler.add(dht22);
+
+  while (true) {
+    try {
+      const auto [sensor, reading, timestamp] = sampler.next();
+      std::cout << "RH: " << reading.humidity << "%, " << reading.temperature
+                << "C, next in " << sampler.interval(sensor).count()
+                << "ms\n";
+    } catch (const std::exception& e) {
+      // The sampler retries the sensor at the minimum interval
+      std::cerr << "read failed: " << e.what() << '\n';
+    }
   }
 }
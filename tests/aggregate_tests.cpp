@@ -0,0 +1,124 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/aggregate.hpp>
+#include <dht/device.hpp>
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace dht;
+using doctest::Approx;
+
+TEST_CASE("test tumbling_window") {
+  tumbling_window window{ 2, 3 };
+
+  CHECK(window.current(0).count == 0);
+  CHECK(window.last(0).count == 0);
+  CHECK_THROWS_AS(window.update(2, {}), std::out_of_range);
+  CHECK_THROWS_AS(window.update(std::vector<response>(3)),
+                  std::invalid_argument);
+
+  window.update({ { 40, 20 }, { 60, 10 } });
+  window.update({ { 44, 23 }, { 60, 10 } });
+  window.update(0, { 42, 26 });
+
+  auto first = window.last(0);
+  CHECK(first.count == 3);
+  CHECK(first.min.humidity == Approx(40));
+  CHECK(first.max.humidity == Approx(44));
+  CHECK(first.mean.humidity == Approx(42));
+  CHECK(first.min.temperature == Approx(20));
+  CHECK(first.max.temperature == Approx(26));
+  CHECK(first.mean.temperature == Approx(23));
+  CHECK(window.current(0).count == 0);
+
+  CHECK(window.last(1).count == 0);
+  CHECK(window.current(1).count == 2);
+  CHECK(window.current(1).mean.humidity == Approx(60));
+
+  window.update(0, { 10, 5 });
+  CHECK(window.current(0).count == 1);
+  CHECK(window.current(0).min.humidity == Approx(10));
+  CHECK(window.last(0).min.humidity == Approx(40));
+}
+
+TEST_CASE("test sliding_window") {
+  sliding_window window{ 2, 3 };
+
+  CHECK(window.count(0) == 0);
+  CHECK(window.mean(0).humidity == Approx(0));
+
+  window.update({ { 10, 1 }, { 50, 5 } });
+  window.update({ { 20, 2 }, { 50, 5 } });
+  CHECK(window.count(0) == 2);
+  CHECK(window.mean(0).humidity == Approx(15));
+
+  window.update(0, { 30, 3 });
+  window.update(0, { 40, 4 });
+  CHECK(window.count(0) == 3);
+  CHECK(window.mean(0).humidity == Approx(30));
+  CHECK(window.mean(0).temperature == Approx(3));
+  CHECK(window.mean(1).humidity == Approx(50));
+
+  // 10 was evicted, the window holds 20, 30 and 40
+  CHECK(window.min(0).humidity == Approx(20));
+  CHECK(window.max(0).humidity == Approx(40));
+  CHECK(window.min(0).temperature == Approx(2));
+  CHECK(window.max(0).temperature == Approx(4));
+
+  window.update(0, { 35, 1 });
+  window.update(0, { 25, 9 });
+  CHECK(window.min(0).humidity == Approx(25));
+  CHECK(window.max(0).humidity == Approx(40));
+  CHECK(window.min(0).temperature == Approx(1));
+  CHECK(window.max(0).temperature == Approx(9));
+
+  window.update(0, { 25, 5 });
+  CHECK(window.max(0).humidity == Approx(35));
+  CHECK(window.min(1).humidity == Approx(50));
+  CHECK(window.max(1).humidity == Approx(50));
+}
+
+TEST_CASE("test sliding_window extremes against a full scan") {
+  constexpr size_t length = 5;
+  sliding_window   window{ 1, length };
+
+  std::vector<float> history;
+  uint32_t           state = 1;
+  for (int i = 0; i < 200; i++) {
+    state = state * 1103515245 + 12345;
+    auto value = static_cast<float>((state >> 16U) % 20);
+    history.push_back(value);
+    window.update(0, { value, -value });
+
+    auto first = history.end() - std::min(history.size(), length);
+    auto [low, high] = std::minmax_element(first, history.end());
+    REQUIRE(window.min(0).humidity == Approx(*low));
+    REQUIRE(window.max(0).humidity == Approx(*high));
+    REQUIRE(window.min(0).temperature == Approx(-*high));
+    REQUIRE(window.max(0).temperature == Approx(-*low));
+  }
+}
+
+TEST_CASE("test ema_filter") {
+  CHECK_THROWS_AS(ema_filter(1, 0.0f), std::invalid_argument);
+
+  ema_filter ema{ 2, 0.5f };
+  ema.update({ { 40, 20 }, { 60, 10 } });
+  CHECK(ema.value(0).humidity == Approx(40));
+  ema.update(0, { 50, 30 });
+  CHECK(ema.value(0).humidity == Approx(45));
+  CHECK(ema.value(0).temperature == Approx(25));
+  CHECK(ema.value(1).humidity == Approx(60));
+}
+
+TEST_CASE("test derived quantities") {
+  CHECK(dew_point({ 100, 20 }) == Approx(20).epsilon(0.01));
+  CHECK(dew_point({ 50, 25 }) == Approx(13.85).epsilon(0.01));
+  CHECK(heat_index({ 40, 20 }) == Approx(19.5).epsilon(0.02));
+  CHECK(heat_index({ 70, 35 }) == Approx(50.3).epsilon(0.02));
+}
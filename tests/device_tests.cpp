@@ -0,0 +1,94 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/device.hpp>
+#include <dht/gpio.hpp>
+#include <dht/trace.hpp>
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using namespace dht;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Edges of a DHT22 response carrying bytes, starting with the preamble
+auto make_frame(const std::array<uint8_t, 5>& bytes) {
+  std::vector<event_data>               frame;
+  std::chrono::steady_clock::time_point now{};
+  uint32_t                              sequence = 1;
+
+  auto pulse = [&](auto low, auto high) {
+    frame.push_back({ now, event_type::falling_edge, sequence++ });
+    now += low;
+    frame.push_back({ now, event_type::rising_edge, sequence++ });
+    now += high;
+  };
+
+  pulse(80us, 80us);
+  for (auto byte: bytes) {
+    for (int bit = 7; bit >= 0; bit--) {
+      pulse(50us, ((byte >> bit) & 1U) != 0 ? 70us : 27us);
+    }
+  }
+  pulse(50us, 0us);
+  return frame;
+}
+
+}  // namespace
+
+TEST_CASE("test decoding response frames") {
+  // 65.2 %RH, 35.1 °C
+  std::array<uint8_t, 5> bytes = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };
+
+  SUBCASE("complete frame") {
+    auto reading = device::decode(make_frame(bytes));
+    REQUIRE(reading.has_value());
+    CHECK(reading->humidity == doctest::Approx(65.2));
+    CHECK(reading->temperature == doctest::Approx(35.1));
+  }
+
+  SUBCASE("frame without preamble") {
+    auto frame = make_frame(bytes);
+    frame.erase(frame.begin(), frame.begin() + 2);
+    auto reading = device::decode(frame);
+    REQUIRE(reading.has_value());
+    CHECK(reading->humidity == doctest::Approx(65.2));
+  }
+
+  SUBCASE("frame starting with the release of the line") {
+    auto frame = make_frame(bytes);
+    frame.insert(frame.begin(),
+                 { frame.front().timestamp - 30us, event_type::rising_edge, 0 });
+    frame.pop_back();
+    auto reading = device::decode(frame);
+    REQUIRE(reading.has_value());
+    CHECK(reading->temperature == doctest::Approx(35.1));
+  }
+
+  SUBCASE("checksum mismatch") {
+    bytes[4]++;
+    CHECK_FALSE(device::decode(make_frame(bytes)).has_value());
+  }
+
+  SUBCASE("truncated frame") {
+    ring_sink<4> sink;
+    set_trace_sink(&sink);
+
+    auto frame = make_frame(bytes);
+    frame.resize(40);
+    CHECK_THROWS_AS(device::decode(frame, 7), frame_error);
+    set_trace_sink(nullptr);
+
+#ifndef DHT_DISABLE_TRACING
+    trace_event event{};
+    REQUIRE(sink.try_pop(event));
+    CHECK(event.kind == trace_kind::frame_error);
+    CHECK(event.line == 7);
+    CHECK(event.expected == 40);
+#endif
+  }
+}
@@ -0,0 +1,255 @@
+#include <dht/event_loop.hpp>
+#include <dht/gpio.hpp>
+
+#include "gpio_sim.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures how edge capture scales with the number of sensors by replaying
+// DHT frames on hundreds of gpio-sim lines. Latency is the time from the
+// kernel timestamp of an edge to its receipt in userspace. Needs root and
+// gpio-sim loaded, e.g. with modprobe gpio-sim.
+//
+// Modes:
+//   single    one thread per line in a blocking gpio_handle::listen()
+//   reactor   one thread reading every line through an event_loop
+//
+// Only edge delivery is measured. The gpio-sim lines are never pulled low
+// by a host, so no mode runs device or poller end to end, and frames are
+// not decoded. There is no group-read mode requesting several lines
+// through one file descriptor: gpio_handle requests a single line and the
+// library has no multi-line request to measure.
+//
+// usage: gpio_scale [-s] [FRAMES [SENSORS...]]
+//   -s  also print latency percentiles of every sensor
+
+using namespace dht;
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+struct run_state {
+  run_state(size_t sensors, size_t frames)
+      : edges(sensors, 0), latencies(sensors) {
+    for (auto& l: latencies) l.reserve(frames * dht_waveform::edges_per_frame);
+  }
+
+  // Called by the single consumer of line for every captured edge
+  void edge(size_t line, const event_data& event) {
+    auto delay = clock_type::now() - event.timestamp;
+    edges[line]++;
+    latencies[line].push_back(
+        std::chrono::duration<double, std::micro>(delay).count());
+  }
+
+  std::vector<size_t>              edges;
+  std::vector<std::vector<double>> latencies;  // per sensor, in µs
+  std::atomic<bool>                done{ false };
+  clock_type::time_point           started;
+  clock_type::time_point           generated;
+};
+
+// Plays frames on every line, sharding the lines across one thread per core
+void generate(const gpio_sim& sim, size_t frames, run_state& state) {
+  auto         workers = std::max(1U, std::thread::hardware_concurrency());
+  dht_waveform waveform;
+
+  std::vector<std::thread> threads;
+
+  for (size_t w = 0; w < workers; w++) {
+    threads.emplace_back([&, w] {
+      for (size_t f = 0; f < frames; f++) {
+        for (size_t line = w; line < sim.size(); line += workers) {
+          waveform.play(sim, sim.at(line));
+        }
+      }
+    });
+  }
+  for (auto& t: threads) t.join();
+  state.generated = clock_type::now();
+
+  // Let the consumers drain what is still queued
+  std::this_thread::sleep_for(200ms);
+  state.done = true;
+}
+
+auto open_lines(const gpio_sim& sim) -> std::vector<gpio_handle> {
+  std::vector<gpio_handle> handles;
+  handles.reserve(sim.size());
+  for (size_t i = 0; i < sim.size(); i++) {
+    auto l = sim.at(i);
+    sim.set_pull(l, true);  // DHT lines idle high
+    handles.emplace_back(l.offset, sim.chip(l.bank));
+    handles.back().event_fd();
+  }
+  return handles;
+}
+
+// One blocking gpio_handle::listen() thread per sensor
+void run_single(const gpio_sim& sim, size_t frames, run_state& state) {
+  auto                     handles = open_lines(sim);
+  std::vector<std::thread> threads;
+
+  for (size_t line = 0; line < handles.size(); line++) {
+    threads.emplace_back([&, line] {
+      while (true) {
+        try {
+          state.edge(line, handles[line].listen());
+        } catch (const timeout_exceeded&) {
+          if (state.done) break;
+        }
+      }
+    });
+  }
+
+  generate(sim, frames, state);
+  for (auto& t: threads) t.join();
+}
+
+// A single thread capturing every sensor through an event_loop
+void run_reactor(const gpio_sim& sim,
+                 size_t          frames,
+                 run_state&      state,
+                 event_backend   backend) {
+  auto       handles = open_lines(sim);
+  event_loop loop{ backend, static_cast<uint32_t>(handles.size()) };
+  for (auto& handle: handles) loop.add(handle);
+
+  std::thread consumer([&] {
+    std::vector<line_event> events;
+    while (true) {
+      events.clear();
+      if (loop.wait(events) == 0 && state.done) break;
+      for (const auto& e: events) state.edge(e.line, e.event);
+    }
+  });
+
+  generate(sim, frames, state);
+  consumer.join();
+}
+
+auto percentile(std::vector<double>& values, double p) -> double {
+  if (values.empty()) return 0;
+  auto n = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + n, values.end());
+  return values[n];
+}
+
+bool per_sensor = false;
+
+template <typename Run>
+void measure(const std::string& mode,
+             size_t             sensors,
+             size_t             frames,
+             Run&&              run) {
+  run_state state{ sensors, frames };
+
+  try {
+    gpio_sim sim{ sensors };
+    state.started = clock_type::now();
+    run(sim, frames, state);
+  } catch (const std::exception& e) {
+    std::printf("%-16s %8zu  failed: %s\n", mode.c_str(), sensors, e.what());
+    return;
+  }
+  auto seconds = std::chrono::duration<double>(state.generated - state.started);
+
+  size_t received = 0;
+  for (auto n: state.edges) received += n;
+  auto expected = sensors * frames * dht_waveform::edges_per_frame;
+  auto missing  = expected - std::min(received, expected);
+  auto lost =
+      100.0 * static_cast<double>(missing) / static_cast<double>(expected);
+
+  std::vector<double> pooled;
+  pooled.reserve(received);
+  for (const auto& l: state.latencies) {
+    pooled.insert(pooled.end(), l.begin(), l.end());
+  }
+
+  // The p99 of the slowest sensor, pooled percentiles hide a starved line
+  double worst = 0;
+  for (auto& l: state.latencies) worst = std::max(worst, percentile(l, 0.99));
+
+  std::printf("%-16s %8zu %12.1f %8.2f%% %10.0f %10.0f %10.0f %10.0f\n",
+              mode.c_str(),
+              sensors,
+              static_cast<double>(received) / seconds.count(),
+              lost,
+              percentile(pooled, 0.50),
+              percentile(pooled, 0.90),
+              percentile(pooled, 0.99),
+              worst);
+
+  if (!per_sensor) return;
+  for (size_t i = 0; i < sensors; i++) {
+    auto& l = state.latencies[i];
+    std::printf("  sensor %-7zu %8zu edges %10.0f %10.0f %10.0f\n",
+                i,
+                state.edges[i],
+                percentile(l, 0.50),
+                percentile(l, 0.90),
+                percentile(l, 0.99));
+  }
+}
+
+void raise_fd_limit() {
+  rlimit limit{};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {  // NOLINT
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (!args.empty() && args.front() == "-s") {
+    per_sensor = true;
+    args.erase(args.begin());
+  }
+
+  size_t              frames  = !args.empty() ? std::stoul(args[0]) : 5;
+  std::vector<size_t> sensors = { 8, 32, 128, 512 };
+  if (args.size() > 1) {
+    sensors.clear();
+    for (size_t i = 1; i < args.size(); i++) {
+      sensors.push_back(std::stoul(args[i]));
+    }
+  }
+
+  raise_fd_limit();
+
+  std::printf("%-16s %8s %12s %9s %10s %10s %10s %10s\n",
+              "mode",
+              "sensors",
+              "edges/s",
+              "lost",
+              "p50 us",
+              "p90 us",
+              "p99 us",
+              "worst p99");
+
+  for (auto n: sensors) {
+    measure("single", n, frames, run_single);
+    measure("reactor/epoll", n, frames, [](auto&... args) {
+      run_reactor(args..., event_backend::epoll);
+    });
+    measure("reactor/io_uring", n, frames, [](auto&... args) {
+      run_reactor(args..., event_backend::io_uring);
+    });
+  }
+}
@@ -0,0 +1,212 @@
+#ifndef DHT_TESTS_GPIO_SIM_HPP
+#define DHT_TESTS_GPIO_SIM_HPP
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // IWYU pragma: keep
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Virtual gpiochips created through the gpio-sim configfs interface, one chip
+ * per bank. Unlike gpio-mockup, lines are driven by setting their simulated
+ * pull, which raises edge events on requested input lines.
+ *
+ * Requires root, configfs mounted at /sys/kernel/config and the gpio-sim
+ * module loaded by the caller, e.g. with modprobe gpio-sim.
+ */
+struct gpio_sim {
+  struct line {
+    size_t   bank;
+    uint32_t offset;
+  };
+
+  explicit gpio_sim(size_t lines,
+                    size_t lines_per_bank = 64,
+                    std::string name      = "libdht-sim")
+      : root(configfs + name) {
+    make_dir(root);
+
+    for (size_t first = 0; first < lines; first += lines_per_bank) {
+      auto count = std::min(lines_per_bank, lines - first);
+      auto bank  = root + "/bank" + std::to_string(banks.size());
+      try {
+        make_dir(bank);
+      } catch (...) {
+        teardown();
+        throw;
+      }
+      write_attr(bank + "/num_lines", std::to_string(count));
+      write_attr(bank + "/label", name + "-" + std::to_string(banks.size()));
+      banks.push_back({ bank, {}, count, {} });
+    }
+
+    write_attr(root + "/live", "1");
+
+    auto device = read_attr(root + "/dev_name");
+    for (auto& bank: banks) {
+      bank.chip     = read_attr(bank.path + "/chip_name");
+      auto sim_base = "/sys/devices/platform/" + device + "/" + bank.chip;
+      for (size_t i = 0; i < bank.lines; i++) {
+        auto path = sim_base + "/sim_gpio" + std::to_string(i) + "/pull";
+        auto fd   = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd == -1) {
+          teardown();
+          throw std::runtime_error("unable to open " + path);
+        }
+        bank.pull_fds.push_back(fd);
+      }
+    }
+  }
+
+  ~gpio_sim() {
+    teardown();
+  }
+
+  gpio_sim(const gpio_sim&) = delete;
+  auto operator=(const gpio_sim&) -> gpio_sim& = delete;
+
+  auto size() const noexcept -> size_t {
+    size_t n = 0;
+    for (const auto& bank: banks) n += bank.lines;
+    return n;
+  }
+
+  auto at(size_t index) const -> line {
+    for (size_t b = 0; b < banks.size(); b++) {
+      if (index < banks[b].lines) return { b, static_cast<uint32_t>(index) };
+      index -= banks[b].lines;
+    }
+    throw std::out_of_range("gpio_sim line out of range");
+  }
+
+  auto chip(size_t bank) const -> std::string {
+    return "/dev/" + banks.at(bank).chip;
+  }
+
+  void set_pull(const line& l, bool up) const {
+    constexpr std::string_view pull_up   = "pull-up";
+    constexpr std::string_view pull_down = "pull-down";
+
+    auto value = up ? pull_up : pull_down;
+    auto fd    = banks[l.bank].pull_fds[l.offset];
+    if (pwrite(fd, value.data(), value.size(), 0) == -1) {
+      throw std::runtime_error("unable to set gpio-sim pull");
+    }
+  }
+
+ private:
+  constexpr static auto configfs = "/sys/kernel/config/gpio-sim/";
+
+  struct bank_state {
+    std::string      path;
+    std::string      chip;
+    size_t           lines;
+    std::vector<int> pull_fds;
+  };
+
+  static void make_dir(const std::string& path) {
+    if (::mkdir(path.c_str(), 0755) == 0) return;
+
+    auto        error  = errno;
+    std::string reason = std::strerror(error);
+    if (error == EEXIST) {
+      reason += ", left behind by an earlier run?";
+    } else if (error == ENOENT) {
+      reason += ", is configfs mounted and gpio-sim loaded?";
+    }
+    throw std::runtime_error("unable to create " + path + ": " + reason);
+  }
+
+  static void write_attr(const std::string& path, const std::string& value) {
+    std::ofstream(path) << value;
+  }
+
+  static auto read_attr(const std::string& path) -> std::string {
+    std::string value;
+    std::ifstream(path) >> value;
+    return value;
+  }
+
+  void teardown() noexcept {
+    for (auto& bank: banks) {
+      for (auto fd: bank.pull_fds) close(fd);
+      bank.pull_fds.clear();
+    }
+    write_attr(root + "/live", "0");
+    for (const auto& bank: banks) ::rmdir(bank.path.c_str());
+    banks.clear();
+    ::rmdir(root.c_str());
+  }
+
+  std::string             root;
+  std::vector<bank_state> banks;
+};
+
+/**
+ * Replays a DHT22 response frame on a gpio_sim line by toggling its pull:
+ * an 80µs low/high preamble, then per bit 50µs low followed by 26µs (0) or
+ * 70µs (1) high, ending with a final low/high pulse. The durations are
+ * busy-waited on a best-effort basis, pull writes take several microseconds.
+ */
+struct dht_waveform {
+  constexpr static size_t edges_per_frame = 2 * (1 + 40 + 1);
+
+  explicit dht_waveform(float humidity = 45.6f, float temperature = 21.3f) {
+    auto h = static_cast<uint16_t>(humidity * 10);
+    auto t = static_cast<uint16_t>(temperature * 10);
+
+    bytes = { static_cast<uint8_t>(h >> 8U),
+              static_cast<uint8_t>(h),
+              static_cast<uint8_t>(t >> 8U),
+              static_cast<uint8_t>(t),
+              0 };
+    bytes[4] =
+        static_cast<uint8_t>(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+  }
+
+  void play(const gpio_sim& sim, const gpio_sim::line& l) const {
+    using namespace std::chrono_literals;
+
+    pulse(sim, l, 80us, 80us);
+    for (auto byte: bytes) {
+      for (int bit = 7; bit >= 0; bit--) {
+        auto one = ((byte >> bit) & 1U) != 0;
+        pulse(sim, l, 50us, one ? 70us : 26us);
+      }
+    }
+    pulse(sim, l, 50us, 0us);
+  }
+
+  std::array<uint8_t, 5> bytes{};
+
+ private:
+  static void pulse(const gpio_sim&           sim,
+                    const gpio_sim::line&     l,
+                    std::chrono::microseconds low,
+                    std::chrono::microseconds high) {
+    sim.set_pull(l, false);
+    spin_for(low);
+    sim.set_pull(l, true);
+    spin_for(high);
+  }
+
+  static void spin_for(std::chrono::microseconds duration) {
+    auto until = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < until) {
+    }
+  }
+};
+
+#endif  // DHT_TESTS_GPIO_SIM_HPP
@@ -1,6 +1,8 @@
 #include <stdexcept>
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/event_loop.hpp>
 #include <dht/gpio.hpp>
+#include <dht/trace.hpp>
 
 #include <doctest/doctest.h>
 
@@ -14,6 +16,7 @@
 #include <fstream>  // IWYU pragma: keep
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -209,4 +212,154 @@ TEST_CASE("test gpio_handle against virtual gpio") {
     CHECK_THROWS_AS(handle.listen(event_request::any, 1ms), timeout_exceeded);
     CHECK_THROWS_AS(handle.listen(event_request::any, 10ms), timeout_exceeded);
   }
+
+  SUBCASE("capture a frame of edges") {
+    auto                    handle = gpio_mockup.new_handle();
+    auto                    pin    = handle.get_pin();
+    std::vector<event_data> frame;
+
+    // Whether a failed capture is final is up to the caller to trace
+    ring_sink<4> sink;
+    set_trace_sink(&sink);
+    try {
+      handle.capture(frame, 2, 5ms);
+      FAIL("capture() returned without any edges");
+    } catch (const frame_error& e) {
+      CHECK(e.why == frame_error::reason::deadline_exceeded);
+      CHECK(e.captured == 0);
+    }
+    set_trace_sink(nullptr);
+    trace_event event{};
+    CHECK_FALSE(sink.try_pop(event));
+
+    gpio_mockup.set_pin(pin, true);
+    gpio_mockup.set_pin(pin, false);
+    gpio_mockup.set_pin(pin, true);
+    handle.capture(frame, 3, 100ms);
+
+    REQUIRE(frame.size() == 3);
+    CHECK(frame[0].type == event_type::rising_edge);
+    CHECK(frame[1].type == event_type::falling_edge);
+    CHECK(frame[2].type == event_type::rising_edge);
+    CHECK(frame[1].sequence == frame[0].sequence + 1);
+    CHECK(frame[2].sequence == frame[1].sequence + 1);
+  }
+
+  SUBCASE("switch between writing and capturing") {
+    auto                    handle = gpio_mockup.new_handle();
+    auto                    pin    = handle.get_pin();
+    std::vector<event_data> frame;
+
+    // The start signal of a read, then listening on the same line
+    handle.write(false);
+    CHECK(gpio_mockup.read_pin(pin) == 0);
+    auto fd = handle.event_fd();
+
+    gpio_mockup.set_pin(pin, true);
+    gpio_mockup.set_pin(pin, false);
+    gpio_mockup.set_pin(pin, true);
+    handle.capture(frame, 2, 100ms);
+    REQUIRE(frame.size() == 2);
+    CHECK(frame[0].type == event_type::rising_edge);
+    CHECK(frame[1].type == event_type::falling_edge);
+
+    // The third edge is never read and must not leak into the next frame
+    handle.write(false);
+    CHECK(gpio_mockup.read_pin(pin) == 0);
+    handle.write(true);
+    CHECK(gpio_mockup.read_pin(pin) == 1);
+    handle.write(false);
+    CHECK(handle.event_fd() == fd);
+
+    gpio_mockup.set_pin(pin, true);
+    gpio_mockup.set_pin(pin, false);
+    handle.capture(frame, 2, 100ms);
+    REQUIRE(frame.size() == 2);
+    CHECK(frame[0].type == event_type::rising_edge);
+    CHECK(frame[1].type == event_type::falling_edge);
+  }
+
+  auto exercise_loop = [&](event_loop& loop) {
+    std::vector<line_event> events;
+
+    auto first  = gpio_mockup.new_handle();
+    auto second = gpio_mockup.new_handle();
+    CHECK(loop.add(first) == 0);
+    CHECK(loop.add(second) == 1);
+    CHECK_THROWS_AS(loop.add(second), std::runtime_error);
+
+    // Only an expired deadline may end an empty wait
+    auto start = std::chrono::steady_clock::now();
+    CHECK(loop.wait(events, 20ms) == 0);
+    CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+
+    gpio_mockup.set_pin(second.get_pin(), true);
+    while (events.empty()) {
+      loop.wait(events);
+    }
+    CHECK(events.front().line == 1);
+    CHECK(events.front().event.type == event_type::rising_edge);
+
+    gpio_mockup.set_pin(first.get_pin(), true);
+    gpio_mockup.set_pin(first.get_pin(), false);
+    events.clear();
+    while (events.size() < 2) {
+      REQUIRE(loop.wait(events) > 0);
+    }
+    CHECK(events[0].line == 0);
+    CHECK(events[0].event.type == event_type::rising_edge);
+    CHECK(events[1].event.type == event_type::falling_edge);
+  };
+
+  SUBCASE("test event_loop backends") {
+    for (auto backend: { event_backend::automatic, event_backend::epoll }) {
+      event_loop loop{ backend, 2 };
+      exercise_loop(loop);
+    }
+  }
+
+  SUBCASE("test event_loop io_uring backend") {
+    std::unique_ptr<event_loop> loop;
+    try {
+      loop = std::make_unique<event_loop>(event_backend::io_uring, 2);
+    } catch (const std::runtime_error& e) {
+      MESSAGE("io_uring unavailable, skipping: " << e.what());
+      return;
+    }
+    CHECK(loop->backend() == event_backend::io_uring);
+    exercise_loop(*loop);
+  }
+}
+
+TEST_CASE("test event_loop notify") {
+  std::vector<event_backend> backends = { event_backend::epoll };
+  try {
+    event_loop probe{ event_backend::io_uring, 1 };
+    backends.push_back(event_backend::io_uring);
+  } catch (const std::runtime_error& e) {
+    MESSAGE("io_uring unavailable, skipping it: " << e.what());
+  }
+
+  for (auto backend: backends) {
+    event_loop              loop{ backend, 1 };
+    std::vector<line_event> events;
+
+    // A wakeup before the wait is not lost, and is consumed by it
+    loop.notify();
+    auto start = std::chrono::steady_clock::now();
+    CHECK(loop.wait(events, 5s) == 0);
+    CHECK(std::chrono::steady_clock::now() - start < 1s);
+
+    CHECK(loop.wait(events, 20ms) == 0);
+    CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+
+    std::thread waker([&] {
+      std::this_thread::sleep_for(20ms);
+      loop.notify();
+    });
+    start = std::chrono::steady_clock::now();
+    CHECK(loop.wait(events, 5s) == 0);
+    CHECK(std::chrono::steady_clock::now() - start < 1s);
+    waker.join();
+  }
 }
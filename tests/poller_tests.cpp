@@ -0,0 +1,293 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/poller.hpp>
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace dht;
+using namespace std::chrono_literals;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Edges of a DHT22 response of 65.2 %RH and 35.1 °C, starting at start
+auto make_frame(clock_type::time_point start) {
+  std::array<uint8_t, 5>  bytes = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };
+  std::vector<event_data> frame;
+  uint32_t                sequence = 1;
+
+  auto pulse = [&](auto low, auto high) {
+    frame.push_back({ start, event_type::falling_edge, sequence++ });
+    start += low;
+    frame.push_back({ start, event_type::rising_edge, sequence++ });
+    start += high;
+  };
+
+  pulse(80us, 80us);
+  for (auto byte: bytes) {
+    for (int bit = 7; bit >= 0; bit--) {
+      pulse(50us, ((byte >> bit) & 1U) != 0 ? 70us : 27us);
+    }
+  }
+  pulse(50us, 0us);
+  return frame;
+}
+
+}  // namespace
+
+TEST_CASE("test shard_sensors") {
+  CHECK_THROWS_AS(shard_sensors({}, 0), std::invalid_argument);
+  CHECK(shard_sensors({}, 4).empty());
+
+  SUBCASE("shares are balanced") {
+    std::vector<sensor_location> sensors;
+    for (uint32_t pin = 0; pin < 10; pin++) {
+      sensors.push_back({ "/dev/gpiochip0", pin });
+    }
+
+    auto shard = shard_sensors(sensors, 4);
+    std::vector<size_t> load(4);
+    for (auto w: shard) load.at(w)++;
+    CHECK(load == std::vector<size_t>{ 3, 3, 2, 2 });
+  }
+
+  SUBCASE("lines of a chip stay together") {
+    std::vector<sensor_location> sensors = {
+      { "/dev/gpiochip1", 3 }, { "/dev/gpiochip0", 7 },
+      { "/dev/gpiochip1", 1 }, { "/dev/gpiochip0", 2 },
+    };
+
+    auto shard = shard_sensors(sensors, 2);
+    CHECK(shard[1] == shard[3]);
+    CHECK(shard[0] == shard[2]);
+    CHECK(shard[0] != shard[1]);
+  }
+
+  SUBCASE("more workers than sensors") {
+    std::vector<sensor_location> sensors = { { "/dev/gpiochip0", 0 } };
+    CHECK(shard_sensors(sensors, 8) == std::vector<size_t>{ 0 });
+  }
+}
+
+TEST_CASE("test capture_cycle") {
+  using phase = capture_cycle::phase;
+
+  sampling_policy policy;
+  auto            start = clock_type::time_point{} + 1h;
+  capture_cycle   cycle{ policy, start };
+  CHECK(cycle.state() == phase::idle);
+  CHECK(cycle.due() == start);
+
+  // Edges outside a capture are not part of any frame
+  CHECK_FALSE(cycle.edge({ start, event_type::falling_edge, 1 }, start));
+  CHECK(cycle.frame().empty());
+
+  CHECK_FALSE(cycle.step(start - 1ms));
+  CHECK(cycle.step(start) == phase::signalling);
+  CHECK(cycle.due() == start + device::start_signal);
+  CHECK_FALSE(cycle.step(start + 1ms));
+
+  auto released = start + device::start_signal;
+  auto deadline = released + device::frame_deadline;
+  CHECK(cycle.step(released) == phase::capturing);
+  CHECK(cycle.due() == deadline);
+
+  auto frame = make_frame(released + 30us);
+
+  SUBCASE("a complete frame is decoded and rescheduled") {
+    // An edge still queued from before the line was released
+    CHECK_FALSE(cycle.edge({ released - 1ms, event_type::rising_edge, 0 },
+                           released));
+    CHECK(cycle.frame().empty());
+
+    for (size_t i = 0; i + 1 < frame.size(); i++) {
+      CHECK_FALSE(cycle.edge(frame[i], released));
+    }
+    CHECK(cycle.edge(frame.back(), released));
+    CHECK(cycle.state() == phase::decoding);
+    CHECK(cycle.due() == clock_type::time_point::max());
+    CHECK_FALSE(cycle.step(deadline));
+
+    // Swapped into a job and back, as the poller does
+    std::vector<event_data> job;
+    job.swap(cycle.frame());
+    REQUIRE(job.size() == device::frame_edges);
+    auto reading = device::decode(job);
+    REQUIRE(reading.has_value());
+    CHECK(reading->humidity == doctest::Approx(65.2));
+    cycle.frame().swap(job);
+
+    cycle.finish(reading);
+    CHECK(cycle.state() == phase::idle);
+    CHECK(cycle.due() == released + policy.min_interval);
+  }
+
+  SUBCASE("a frame without preamble is complete at the deadline") {
+    for (size_t i = 2; i < frame.size(); i++) {
+      CHECK_FALSE(cycle.edge(frame[i], released));
+    }
+    CHECK_FALSE(cycle.step(deadline - 1us));
+    CHECK(cycle.step(deadline) == phase::decoding);
+    CHECK(cycle.frame().size() == device::data_edges);
+  }
+
+  SUBCASE("a short frame fails at the deadline") {
+    for (size_t i = 0; i < 10; i++) cycle.edge(frame[i], released);
+    CHECK_THROWS_AS(cycle.step(deadline), frame_error);
+    CHECK(cycle.state() == phase::idle);
+    CHECK(cycle.due() == deadline + policy.min_interval);
+  }
+
+  SUBCASE("a dropped edge fails the frame") {
+    auto now = released + 1ms;
+    CHECK_FALSE(cycle.edge(frame[0], now));
+    CHECK_THROWS_AS(cycle.edge(frame[2], now), frame_error);
+    CHECK(cycle.state() == phase::idle);
+    CHECK(cycle.due() == now + policy.min_interval);
+  }
+
+  SUBCASE("a frame that did not decode is retried at the minimum interval") {
+    for (const auto& e: frame) cycle.edge(e, released);
+    REQUIRE(cycle.state() == phase::decoding);
+    cycle.finish(std::nullopt);
+    CHECK(cycle.state() == phase::idle);
+    CHECK(cycle.due() == released + policy.min_interval);
+  }
+
+  SUBCASE("stable readings back off from the release of the line") {
+    for (const auto& e: frame) cycle.edge(e, released);
+    cycle.finish(response{ 65.2f, 35.1f });
+
+    auto again = released + policy.min_interval;
+    REQUIRE(cycle.step(again) == phase::signalling);
+    auto released_again = again + device::start_signal;
+    REQUIRE(cycle.step(released_again) == phase::capturing);
+    for (const auto& e: make_frame(released_again)) {
+      cycle.edge(e, released_again);
+    }
+    cycle.finish(response{ 65.2f, 35.1f });
+    CHECK(cycle.due() == released_again + 2 * policy.min_interval);
+  }
+}
+
+TEST_CASE("test work_queues") {
+  work_queues<int> queues{ 3 };
+  CHECK(queues.size() == 3);
+  CHECK_FALSE(queues.pop(0));
+
+  SUBCASE("own jobs newest first, stolen jobs oldest first") {
+    CHECK(queues.push(0, 1) == 1);
+    CHECK(queues.push(0, 2) == 2);
+    CHECK(queues.push(0, 3) == 3);
+
+    CHECK(queues.pop(1) == 1);
+    CHECK(queues.pop(0) == 3);
+    CHECK(queues.pop(2) == 2);
+    CHECK_FALSE(queues.pop(0));
+  }
+
+  SUBCASE("own jobs before stolen ones") {
+    queues.push(0, 1);
+    queues.push(1, 2);
+    CHECK(queues.pop(1) == 2);
+    CHECK(queues.pop(1) == 1);
+  }
+
+  SUBCASE("parking fails while jobs are queued") {
+    queues.push(2, 1);
+    CHECK_FALSE(queues.park(0));
+    CHECK_FALSE(queues.claim_idle(2));
+
+    CHECK(queues.pop(0) == 1);
+    CHECK(queues.park(0));
+  }
+
+  SUBCASE("a parked worker is claimed once") {
+    CHECK(queues.park(1));
+    CHECK(queues.park(2));
+
+    auto first = queues.claim_idle(0);
+    REQUIRE(first);
+    CHECK(*first == 1);
+    CHECK(queues.claim_idle(0) == 2);
+    CHECK_FALSE(queues.claim_idle(0));
+  }
+
+  SUBCASE("a worker never claims itself") {
+    CHECK(queues.park(0));
+    CHECK_FALSE(queues.claim_idle(0));
+    queues.unpark(0);
+    CHECK_FALSE(queues.claim_idle(1));
+  }
+}
+
+TEST_CASE("test work_queues job flow") {
+  constexpr size_t workers = 4;
+  constexpr int    jobs    = 20000;
+
+  // Worker 0 produces everything and only starts decoding its own backlog
+  // once a thief got a job, the others live off stealing
+  work_queues<int>              queues{ workers };
+  std::vector<std::atomic<int>> taken(jobs);
+  std::vector<size_t>           done(workers);
+  std::atomic<int>              consumed{ 0 };
+  std::atomic<bool>             stolen{ false };
+
+  std::vector<std::thread> threads;
+  for (size_t w = 0; w < workers; w++) {
+    threads.emplace_back([&, w] {
+      if (w == 0) {
+        for (int job = 0; job < jobs; job++) queues.push(0, job);
+        while (!stolen) std::this_thread::yield();
+      }
+      while (consumed < jobs) {
+        auto job = queues.pop(w);
+        if (!job) continue;
+        if (w != 0) stolen = true;
+        taken[*job]++;
+        done[w]++;
+        consumed++;
+      }
+    });
+  }
+  for (auto& t: threads) t.join();
+
+  for (const auto& count: taken) CHECK(count == 1);
+  size_t thieves = 0;
+  for (size_t w = 1; w < workers; w++) thieves += done[w];
+  CHECK(thieves > 0);
+  CHECK(done[0] + thieves == jobs);
+}
+
+TEST_CASE("test poller lifecycle") {
+  poller_options options;
+  options.workers     = 3;
+  options.pin_workers = false;
+
+  SUBCASE("start and stop without sensors") {
+    poller p{ [](size_t, const response&) {}, options };
+    p.start();
+    CHECK(p.workers() == 3);
+    CHECK_THROWS_AS(p.add(2), std::logic_error);
+    CHECK_THROWS_AS(p.start(), std::logic_error);
+    p.stop();
+    CHECK(p.workers() == 0);
+  }
+
+  SUBCASE("start reports devices failing to open") {
+    poller p{ [](size_t, const response&) {}, options };
+    CHECK(p.add(2, "/dev/does-not-exist") == 0);
+    CHECK_THROWS_AS(p.start(), std::runtime_error);
+    CHECK(p.workers() == 0);
+  }
+}
@@ -0,0 +1,145 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/device.hpp>
+#include <dht/sampler.hpp>
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace dht;
+
+TEST_CASE("test adaptive_interval") {
+  sampling_policy policy;
+  policy.min_interval      = 2s;
+  policy.max_interval      = 10s;
+  policy.humidity_delta    = 1.0f;
+  policy.temperature_delta = 0.5f;
+  policy.backoff           = 2.0f;
+
+  adaptive_interval schedule{ policy };
+  CHECK(schedule.interval() == 2s);
+
+  SUBCASE("first reading samples at the minimum") {
+    CHECK(schedule.update({ 40.0f, 20.0f }) == 2s);
+  }
+
+  SUBCASE("stable readings back off up to the maximum") {
+    schedule.update({ 40.0f, 20.0f });
+    CHECK(schedule.update({ 40.5f, 20.2f }) == 4s);
+    CHECK(schedule.update({ 39.5f, 19.8f }) == 8s);
+    CHECK(schedule.update({ 40.0f, 20.0f }) == 10s);
+    CHECK(schedule.update({ 40.0f, 20.0f }) == 10s);
+  }
+
+  SUBCASE("a change drops back to the minimum") {
+    schedule.update({ 40.0f, 20.0f });
+    schedule.update({ 40.0f, 20.0f });
+    schedule.update({ 40.0f, 20.0f });
+    CHECK(schedule.update({ 40.0f, 21.0f }) == 2s);
+    CHECK(schedule.update({ 42.0f, 21.0f }) == 2s);
+    CHECK(schedule.update({ 42.0f, 21.0f }) == 4s);
+  }
+
+  SUBCASE("slow drift is compared against the last significant reading") {
+    schedule.update({ 40.0f, 20.0f });
+    CHECK(schedule.update({ 40.0f, 20.3f }) == 4s);
+    CHECK(schedule.update({ 40.0f, 20.6f }) == 2s);
+  }
+
+  SUBCASE("min_interval above max_interval is rejected") {
+    policy.min_interval = 20s;
+    CHECK_THROWS_AS(adaptive_interval{ policy }, std::invalid_argument);
+  }
+
+  SUBCASE("a backoff below 1 is rejected") {
+    for (auto backoff: { 0.5f, 0.0f, -2.0f, std::nanf("") }) {
+      policy.backoff = backoff;
+      CHECK_THROWS_AS(adaptive_interval{ policy }, std::invalid_argument);
+    }
+  }
+
+  SUBCASE("a huge backoff jumps to the maximum") {
+    policy.backoff = 1e30f;
+    adaptive_interval fast{ policy };
+    fast.update({ 40.0f, 20.0f });
+    CHECK(fast.update({ 40.0f, 20.0f }) == 10s);
+  }
+
+  SUBCASE("reset returns to the minimum") {
+    schedule.update({ 40.0f, 20.0f });
+    schedule.update({ 40.0f, 20.0f });
+    CHECK(schedule.reset() == 2s);
+    CHECK(schedule.update({ 40.0f, 20.0f }) == 2s);
+  }
+}
+
+TEST_CASE("test sampler") {
+  using clock = std::chrono::steady_clock;
+
+  sampler sampler;
+  CHECK_THROWS_AS(sampler.next(), std::logic_error);
+
+  SUBCASE("invalid policies are rejected on add") {
+    sampling_policy policy;
+    policy.min_interval = 2s;
+    policy.max_interval = 1s;
+    CHECK_THROWS_AS(sampler.add([] { return response{}; }, policy),
+                    std::invalid_argument);
+    CHECK(sampler.size() == 0);
+  }
+
+  SUBCASE("the earliest due sensor is polled first") {
+    sampling_policy stable_policy;
+    stable_policy.min_interval = 1ms;
+    stable_policy.max_interval = 1s;
+    stable_policy.backoff      = 100;
+
+    sampling_policy changing_policy;
+    changing_policy.min_interval = 5ms;
+
+    auto stable   = [] { return response{ 40.0f, 20.0f }; };
+    auto changing = [temperature = 0.0f]() mutable {
+      temperature += 10;
+      return response{ 40.0f, temperature };
+    };
+    CHECK(sampler.add(stable, stable_policy) == 0);
+    CHECK(sampler.add(changing, changing_policy) == 1);
+
+    // The stable sensor backs off to 100ms after its second reading, the
+    // changing one stays due every 5ms
+    std::vector<size_t> order;
+    for (int i = 0; i < 6; i++) {
+      order.push_back(sampler.next().sensor);
+    }
+    CHECK(order == std::vector<size_t>{ 0, 1, 0, 1, 1, 1 });
+    CHECK(sampler.interval(0) == 100ms);
+    CHECK(sampler.interval(1) == 5ms);
+  }
+
+  SUBCASE("a failing sensor is retried at the minimum interval") {
+    sampling_policy policy;
+    policy.min_interval = 20ms;
+    policy.max_interval = 1s;
+
+    auto fail = true;
+    sampler.add(
+        [&] {
+          if (fail) throw std::runtime_error("no response");
+          return response{ 40.0f, 20.0f };
+        },
+        policy);
+
+    CHECK_THROWS_AS(sampler.next(), std::runtime_error);
+    CHECK(sampler.interval(0) == 20ms);
+
+    fail       = false;
+    auto start = clock::now();
+    auto next  = sampler.next();
+    CHECK(clock::now() - start >= 10ms);
+    CHECK(next.sensor == 0);
+    CHECK(next.reading.humidity == doctest::Approx(40.0));
+  }
+}
@@ -0,0 +1,99 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <dht/trace.hpp>
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace dht;
+
+TEST_CASE("test ring_sink") {
+  ring_sink<4> sink;
+  trace_event  event{};
+
+  SUBCASE("empty sink has nothing to pop") {
+    CHECK_FALSE(sink.try_pop(event));
+    CHECK(sink.dropped() == 0);
+  }
+
+  SUBCASE("events are popped in order") {
+    sink.record({ {}, trace_kind::frame_start, 2 });
+    sink.record({ {}, trace_kind::crc_error, 2, 0x12, 0x34 });
+    REQUIRE(sink.try_pop(event));
+    CHECK(event.kind == trace_kind::frame_start);
+    REQUIRE(sink.try_pop(event));
+    CHECK(event.kind == trace_kind::crc_error);
+    CHECK(event.value == 0x12);
+    CHECK(event.expected == 0x34);
+    CHECK_FALSE(sink.try_pop(event));
+  }
+
+  SUBCASE("full sink drops instead of blocking") {
+    for (uint32_t i = 0; i < 6; i++) {
+      sink.record({ {}, trace_kind::edge_count, 0, i });
+    }
+    CHECK(sink.dropped() == 2);
+    std::vector<uint32_t> values;
+    CHECK(sink.drain([&](const trace_event& e) { values.push_back(e.value); })
+          == 4);
+    CHECK(values == std::vector<uint32_t>{ 0, 1, 2, 3 });
+  }
+
+  SUBCASE("sink wraps around") {
+    for (uint32_t i = 0; i < 10; i++) {
+      sink.record({ {}, trace_kind::edge_count, 0, i });
+      REQUIRE(sink.try_pop(event));
+      CHECK(event.value == i);
+    }
+  }
+}
+
+TEST_CASE("test concurrent producers") {
+  constexpr uint32_t producers = 4;
+  constexpr uint32_t per_thread = 1000;
+
+  ring_sink<8192>          sink;
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([&, p] {
+      for (uint32_t i = 0; i < per_thread; i++) {
+        sink.record({ {}, trace_kind::edge_count, p, i });
+      }
+    });
+  }
+  for (auto& t: threads) t.join();
+
+  std::vector<uint32_t> next(producers, 0);
+  auto                  n = sink.drain([&](const trace_event& e) {
+    CHECK(e.value == next[e.line]);
+    next[e.line]++;
+  });
+  CHECK(n == producers * per_thread);
+  CHECK(sink.dropped() == 0);
+}
+
+TEST_CASE("test trace dispatch") {
+  ring_sink<4> sink;
+  trace_event  event{};
+
+  CHECK(get_trace_sink() == nullptr);
+  trace(trace_kind::timeout, 1, 100);
+
+  set_trace_sink(&sink);
+  trace(trace_kind::timeout, 1, 100);
+  set_trace_sink(nullptr);
+  trace(trace_kind::timeout, 1, 100);
+
+#ifdef DHT_DISABLE_TRACING
+  // Compiled out, an installed sink never sees an event
+  CHECK_FALSE(sink.try_pop(event));
+#else
+  REQUIRE(sink.try_pop(event));
+  CHECK(event.kind == trace_kind::timeout);
+  CHECK(event.line == 1);
+  CHECK(event.value == 100);
+  CHECK_FALSE(sink.try_pop(event));
+#endif
+}
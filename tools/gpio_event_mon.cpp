@@ -24,8 +24,9 @@ int main(int argc, char** argv) {  // NOLINT
 
   std::cout << "Listening on chip " << chip << " pin " << pin << '\n';
   while (true) {
-    auto [timestamp, event] = handle.listen();
+    auto [timestamp, event, sequence] = handle.listen();
     std::cout << "GPIO event " << to_string(event) << " @ "
-              << timestamp.time_since_epoch().count() << '\n';
+              << timestamp.time_since_epoch().count() << " #" << sequence
+              << '\n';
   }
 }